@@ -1,7 +1,10 @@
 #ifndef ALLOCATOR_H
 #define ALLOCATOR_H
 
+#include "handle_table.h"
+#include "pool.h"
 #include <cstddef>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -9,14 +12,42 @@ using namespace std;
 
 struct MemoryBlock {
   size_t size;
+  size_t requested_size;
   bool allocated;
   size_t address;
   MemoryBlock *prev;
   MemoryBlock *next;
+  MemoryBlock *bin_prev; // segregated free list links (TLSF)
+  MemoryBlock *bin_next;
 
   MemoryBlock(size_t sz, size_t addr)
-      : size(sz), allocated(false), address(addr), prev(nullptr),
-        next(nullptr) {}
+      : size(sz), requested_size(sz), allocated(false), address(addr),
+        prev(nullptr), next(nullptr), bin_prev(nullptr), bin_next(nullptr) {}
+};
+
+// Boundary tag mode: every block carries a header and a footer word in the
+// simulated memory holding (size | allocated bit). A free block also stores
+// its MemoryBlock node right after the header.
+const size_t BOUNDARY_TAG_SIZE = sizeof(size_t);
+const size_t BOUNDARY_TAG_ALIGN = sizeof(size_t);
+const size_t MIN_TAGGED_BLOCK_SIZE =
+    2 * BOUNDARY_TAG_SIZE + sizeof(MemoryBlock *);
+
+// Orders free blocks by size, then by address so ties resolve the same way
+// as a scan of the address-ordered free list.
+struct FreeBlockBySize {
+  bool operator()(const MemoryBlock *a, const MemoryBlock *b) const {
+    if (a->size != b->size) {
+      return a->size < b->size;
+    }
+    return a->address < b->address;
+  }
+};
+
+struct FreeBlockByAddress {
+  bool operator()(const MemoryBlock *a, const MemoryBlock *b) const {
+    return a->address < b->address;
+  }
 };
 
 struct AllocationStats {
@@ -28,13 +59,21 @@ struct AllocationStats {
   size_t allocation_failures;
   size_t num_free_blocks;
   size_t num_allocated_blocks;
+  size_t largest_free_block;
+  size_t internal_fragmentation_bytes;
+  size_t tag_overhead_bytes;
+  size_t metadata_nodes;
+  size_t metadata_pool_bytes;
   double external_fragmentation;
   double internal_fragmentation;
 
   AllocationStats()
       : total_memory(0), used_memory(0), free_memory(0), num_allocations(0),
         num_deallocations(0), allocation_failures(0), num_free_blocks(0),
-        num_allocated_blocks(0), external_fragmentation(0.0),
+        num_allocated_blocks(0), largest_free_block(0),
+        internal_fragmentation_bytes(0), tag_overhead_bytes(0),
+        metadata_nodes(0),
+        metadata_pool_bytes(0), external_fragmentation(0.0),
         internal_fragmentation(0.0) {}
 };
 
@@ -54,22 +93,39 @@ protected:
   char *memory;
   size_t memory_size;
   MemoryBlock *free_list_head;
-  vector<MemoryBlock *> allocated_blocks;
-  size_t next_block_id;
+  ObjectPool<MemoryBlock> block_pool;
+  SlabPool index_node_pool;
+  set<MemoryBlock *, FreeBlockBySize, PoolAllocator<MemoryBlock *>>
+      free_blocks_by_size;
+  HandleTable<MemoryBlock> allocated_blocks;
   AllocationStats stats;
+  bool boundary_tags;
 
   MemoryBlock *find_block(size_t block_id);
+  virtual void index_free_block(MemoryBlock *block);
+  virtual void unindex_free_block(MemoryBlock *block);
   void add_to_free_list(MemoryBlock *block);
   void remove_from_free_list(MemoryBlock *block);
+  MemoryBlock *split_free_block(MemoryBlock *free_block, size_t size);
   MemoryBlock *coalesce(MemoryBlock *block);
+  MemoryBlock *coalesce_tagged(MemoryBlock *block);
+  size_t block_size_for(size_t size) const;
+  AllocationResult allocate_from(MemoryBlock *free_block, size_t size);
+
+  void write_tags(MemoryBlock *block);
+  size_t read_tag(size_t offset, bool &allocated) const;
+  MemoryBlock *tagged_free_block_at(size_t address) const;
   void update_stats();
   void calculate_fragmentation();
+  virtual size_t largest_free_block() const;
 
 public:
   MemoryAllocator();
   virtual ~MemoryAllocator();
 
   bool init(size_t size);
+  virtual void set_boundary_tags(bool enabled) { boundary_tags = enabled; }
+  bool uses_boundary_tags() const { return boundary_tags; }
   virtual AllocationResult allocate(size_t size) = 0;
   bool deallocate(size_t block_id);
 
@@ -89,6 +145,14 @@ public:
 
 protected:
   MemoryBlock *find_free_block(size_t size) override;
+  void index_free_block(MemoryBlock *block) override;
+  void unindex_free_block(MemoryBlock *block) override;
+
+private:
+  // With boundary tags the free list is unordered, so first fit scans this
+  // instead to still take the lowest address.
+  set<MemoryBlock *, FreeBlockByAddress, PoolAllocator<MemoryBlock *>>
+      free_blocks_by_address;
 };
 
 class BestFitAllocator : public MemoryAllocator {
@@ -109,4 +173,36 @@ protected:
   MemoryBlock *find_free_block(size_t size) override;
 };
 
+// Two-level segregated fit: sizes map to (fl, sl) classes, fl by the
+// position of the top bit and sl by the next TLSF_SL_INDEX_LOG2 bits below it.
+const size_t TLSF_SL_INDEX_LOG2 = 4;
+const size_t TLSF_SL_INDEX_COUNT = 1 << TLSF_SL_INDEX_LOG2;
+const size_t TLSF_ALIGN_LOG2 = 3;
+const size_t TLSF_FL_INDEX_SHIFT = TLSF_SL_INDEX_LOG2 + TLSF_ALIGN_LOG2;
+const size_t TLSF_SMALL_BLOCK_SIZE = 1 << TLSF_FL_INDEX_SHIFT;
+const size_t TLSF_FL_INDEX_COUNT = 64 - TLSF_FL_INDEX_SHIFT + 1;
+
+class TLSFAllocator : public MemoryAllocator {
+public:
+  TLSFAllocator();
+  AllocationResult allocate(size_t size) override;
+
+  // TLSF always merges physical neighbours through boundary tags.
+  void set_boundary_tags(bool) override {}
+
+protected:
+  MemoryBlock *find_free_block(size_t size) override;
+  void index_free_block(MemoryBlock *block) override;
+  void unindex_free_block(MemoryBlock *block) override;
+  size_t largest_free_block() const override;
+
+private:
+  size_t fl_bitmap;
+  unsigned int sl_bitmap[TLSF_FL_INDEX_COUNT];
+  MemoryBlock *bins[TLSF_FL_INDEX_COUNT][TLSF_SL_INDEX_COUNT];
+
+  static void mapping_insert(size_t size, size_t &fl, size_t &sl);
+  static void mapping_search(size_t size, size_t &fl, size_t &sl);
+};
+
 #endif
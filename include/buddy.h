@@ -1,8 +1,9 @@
 #ifndef BUDDY_H
 #define BUDDY_H
 
+#include "handle_table.h"
+#include "pool.h"
 #include <cstddef>
-#include <map>
 #include <string>
 #include <vector>
 
@@ -10,14 +11,19 @@ using namespace std;
 
 struct AllocationStats;
 
+const size_t BUDDY_MAX_ORDERS = 64;
+
 struct BuddyBlock {
   size_t address;
   size_t size;
+  size_t requested_size;
   bool allocated;
+  BuddyBlock *prev;
   BuddyBlock *next;
 
   BuddyBlock(size_t addr, size_t sz)
-      : address(addr), size(sz), allocated(false), next(nullptr) {}
+      : address(addr), size(sz), requested_size(sz), allocated(false),
+        prev(nullptr), next(nullptr) {}
 };
 
 struct BuddyAllocationResult {
@@ -40,15 +46,23 @@ private:
   size_t min_block_size;
   size_t max_block_size;
 
-  map<size_t, BuddyBlock *> free_lists;
+  BuddyBlock *free_lists[BUDDY_MAX_ORDERS];
+  size_t free_orders_mask; // bit k set while free_lists[k] is non-empty
+
+  // free_map[order][address >> order] is set while a free block of that
+  // order starts at address. Free blocks keep their node pointer in the
+  // first bytes of their simulated memory, so a buddy is found in O(1).
+  vector<vector<bool>> free_map;
 
-  map<size_t, BuddyBlock *> allocated_blocks;
-  size_t next_block_id;
+  ObjectPool<BuddyBlock> block_pool;
+  HandleTable<BuddyBlock> allocated_blocks;
 
   size_t total_allocations;
   size_t total_deallocations;
   size_t allocation_failures;
   size_t internal_fragmentation_bytes;
+  size_t used_bytes;
+  size_t num_free_blocks;
 
   size_t round_up_to_power_of_two(size_t size);
   size_t log2_size(size_t size);
@@ -1,21 +1,114 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include "sampling.h"
+#include "stack_distance.h"
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 using namespace std;
-enum class ReplacementPolicy { FIFO, LRU, LFU };
+
+class Prefetcher;
+
+enum class ReplacementPolicy {
+  FIFO,
+  LRU,
+  LFU,
+  TREE_PLRU, // binary tree of ways - 1 direction bits per set
+  BIT_PLRU,  // one MRU bit per way
+  SRRIP,     // 2-bit re-reference prediction value per way
+  BRRIP,     // SRRIP that mostly inserts at distant re-reference
+  RANDOM
+};
+
+enum class AccessType { READ, WRITE };
+
+enum class WritePolicy { WRITE_BACK, WRITE_THROUGH };
+
+// How the contents of the levels relate:
+//  NINE       each level fills on a miss; nothing is invalidated or moved
+//  INCLUSIVE  as NINE, and a lower-level eviction back-invalidates the
+//             block in every level above
+//  EXCLUSIVE  a block lives in one level; misses fill L1 only, a lower-level
+//             hit moves the line up, and victims move down one level
+enum class InclusionPolicy { NINE, INCLUSIVE, EXCLUSIVE };
+
+bool parse_inclusion_policy(const string &name, InclusionPolicy &policy);
+const char *inclusion_policy_name(InclusionPolicy policy);
+
+// Stores carry no size, so a write-through or no-write-allocate store sends
+// one word to the level below.
+const size_t CACHE_WORD_BYTES = 8;
+
+inline bool is_power_of_two(size_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+bool parse_replacement_policy(const string &name, ReplacementPolicy &policy);
+const char *replacement_policy_name(ReplacementPolicy policy);
+
+// Hardware prefetcher attached to a level (prefetch.h):
+//  NEXT_LINE  on a miss or first use of a prefetched line, the next blocks
+//  STRIDE     per 4 KiB region, the blocks a confirmed stride leads to
+//  STREAM     FIFO stream buffers beside the level, filled on misses
+enum class PrefetchKind { NONE, NEXT_LINE, STRIDE, STREAM };
+
+// degree blocks are requested per trigger, starting distance blocks (or
+// strides) ahead of the access.
+struct PrefetchConfig {
+  PrefetchKind kind;
+  size_t degree;
+  size_t distance;
+
+  PrefetchConfig(PrefetchKind k = PrefetchKind::NONE, size_t deg = 1,
+                 size_t dist = 1)
+      : kind(k), degree(deg), distance(dist) {}
+};
+
+bool parse_prefetch_kind(const string &name, PrefetchKind &kind);
+const char *prefetch_kind_name(PrefetchKind kind);
 
 struct CacheStats {
   string level_name;
   size_t accesses;
   size_t hits;
   size_t misses;
+  size_t writes;
+  size_t dirty_evictions;
+  // Bytes sent to the level below (or memory): dirty victims, write-through
+  // and no-write-allocate stores.
+  size_t writeback_bytes;
+  size_t back_invalidations; // lines dropped to keep an inclusive hierarchy
+  size_t victims_received;   // lines moved in from the level above
+  size_t prefetch_fills;     // lines a prefetch brought in
+  size_t useful_prefetches;  // ... that a demand access used
+  size_t late_prefetches;    // demand misses on a prefetch still in flight
+  size_t prefetch_pollution; // demand misses on lines a prefetch evicted
+  // 3C classes of the misses, and the reuse-distance histogram, when the
+  // level classifies them.
+  bool classified;
+  // First touches come from a hashed bitmap of 2^22 bits, two per block. A
+  // first touch whose bits are both set already counts as capacity instead:
+  // about (1 - e^(-2n / 2^22))^2 of them after n distinct blocks, so 0.2% at
+  // 100k blocks and 14% at 1M.
+  size_t compulsory_misses; // first access to the block
+  size_t capacity_misses;   // ... a fully associative LRU would miss too
+  size_t conflict_misses;   // ... it would hit
+  // reuse_histogram[d] counts demand accesses at distance d, for d below
+  // the level's line count; distant_reuses counts the ones further back.
+  vector<uint64_t> reuse_histogram;
+  size_t distant_reuses;
 
   CacheStats(const string &name = "")
-      : level_name(name), accesses(0), hits(0), misses(0) {}
+      : level_name(name), accesses(0), hits(0), misses(0), writes(0),
+        dirty_evictions(0), writeback_bytes(0), back_invalidations(0),
+        victims_received(0), prefetch_fills(0), useful_prefetches(0),
+        late_prefetches(0), prefetch_pollution(0), classified(false),
+        compulsory_misses(0), capacity_misses(0), conflict_misses(0),
+        distant_reuses(0) {}
 
   double hit_ratio() const {
     return accesses > 0 ? static_cast<double>(hits) / accesses * 100.0 : 0.0;
@@ -28,64 +121,303 @@ struct CacheConfig {
   size_t block_size;
   size_t associativity;
   ReplacementPolicy policy;
+  WritePolicy write_policy;
+  bool write_allocate;
+  PrefetchConfig prefetch;
+  // Cycles to look the level up, extra cycles before a miss goes down, and
+  // (last level only) cycles to fetch a block from memory.
+  size_t hit_latency;
+  size_t miss_penalty;
+  size_t memory_latency;
+  // Keep a shadow fully associative LRU of the same capacity to split
+  // misses into compulsory, capacity and conflict.
+  bool classify_misses;
 
   CacheConfig(const string &n = "", size_t size = 0, size_t block = 0,
-              size_t assoc = 1, ReplacementPolicy p = ReplacementPolicy::FIFO)
+              size_t assoc = 1, ReplacementPolicy p = ReplacementPolicy::FIFO,
+              WritePolicy w = WritePolicy::WRITE_BACK, bool allocate = true)
       : name(n), size_bytes(size), block_size(block), associativity(assoc),
-        policy(p) {}
+        policy(p), write_policy(w), write_allocate(allocate), hit_latency(1),
+        miss_penalty(0), memory_latency(100), classify_misses(false) {}
+};
+
+// Cycle totals of the demand accesses to one chain of levels. Translation
+// cycles are the page walks and faults of vm_access, charged to the access
+// that follows them.
+struct LatencyStats {
+  uint64_t accesses;
+  uint64_t cache_cycles;
+  uint64_t translation_cycles;
+  // Accesses by total latency: bucket b holds [2^b, 2^(b+1)) cycles, and
+  // bucket 0 also holds 0.
+  vector<uint64_t> histogram;
+
+  LatencyStats()
+      : accesses(0), cache_cycles(0), translation_cycles(0), histogram(64, 0) {}
+
+  uint64_t total_cycles() const { return cache_cycles + translation_cycles; }
+  double amat() const {
+    return accesses > 0 ? static_cast<double>(cache_cycles) / accesses : 0.0;
+  }
+};
+
+// Serial lookup cost model: an access that hits level k pays every level's
+// hit_latency up to k and the miss_penalty of each level above k; a miss in
+// all levels also pays the last level's memory_latency. Writebacks and
+// prefetch fills are off the critical path and cost nothing.
+class LatencyModel {
+public:
+  LatencyModel() : memory_cycles(0) {}
+
+  void set_levels(const vector<CacheConfig> &configs);
+  // hit_level as returned by the hierarchy, -1 for memory.
+  uint64_t cost(int hit_level) const {
+    return hit_level < 0 ? memory_cycles : hit_cycles[hit_level];
+  }
+  void record(int hit_level, uint64_t translation_cycles = 0);
+
+  const LatencyStats &get_stats() const { return stats; }
+  void reset() { stats = LatencyStats(); }
+
+private:
+  vector<uint64_t> hit_cycles;
+  uint64_t memory_cycles;
+  LatencyStats stats;
+};
+
+// Traffic an access sends to the level below besides the demand miss.
+struct CacheSpill {
+  bool evicted;          // a valid line was replaced
+  bool victim_dirty;     // ... and it was dirty, so it must be written back
+  size_t victim_address; // first byte of the evicted block
+  bool write_through;    // the stored word goes down as well
+
+  CacheSpill()
+      : evicted(false), victim_dirty(false), victim_address(0),
+        write_through(false) {}
 };
 
 class CacheLevel {
 public:
   explicit CacheLevel(const CacheConfig &config = CacheConfig());
 
-  bool access(size_t address);
+  bool access(size_t address, AccessType type, CacheSpill &spill) {
+    return (this->*access_path)(address, type, spill);
+  }
+
+  // Takes data written back or written through from the level above. This
+  // is not a demand access: it only marks or allocates the line. Returns
+  // true when the data stays here, false when it must go further down.
+  // Without allocate, a missing line is never filled.
+  bool absorb_write(size_t address, size_t bytes, CacheSpill &spill,
+                    bool allocate = true);
+
+  // Exclusive-hierarchy primitives. take() is a demand lookup that removes
+  // the line on a hit; insert_victim() places a line evicted from the level
+  // above; invalidate() drops the line holding address for inclusion.
+  bool take(size_t address, bool &dirty);
+  void insert_victim(size_t address, bool dirty, CacheSpill &spill);
+  bool invalidate(size_t address, bool &dirty);
+
+  // Coherence snoops (coherence.h). Neither counts as an access or touches
+  // replacement state. probe() reports whether address is held and dirty;
+  // snoop() then drops the line or, without invalidate, cleans it.
+  bool probe(size_t address, bool &dirty) const;
+  bool snoop(size_t address, bool invalidate, bool &dirty);
 
-  const CacheStats &get_stats() const { return stats; }
+  // Fills address on behalf of a prefetcher: no demand stats, and the line
+  // counts as useful on its first demand hit. Returns false when the line
+  // is already present.
+  bool prefetch_fill(size_t address, CacheSpill &spill);
+  // Fills address with no stats at all, to keep an inclusive level below a
+  // prefetch fill holding the block. Returns false when it is present.
+  bool install(size_t address, CacheSpill &spill);
+  // True once after a demand hit on a line a prefetch brought in.
+  bool take_prefetch_hit() {
+    bool hit = prefetch_hit;
+    prefetch_hit = false;
+    return hit;
+  }
+  // Prefetch outcomes decided outside the level: a late prefetch, and the
+  // fills and hits of a stream buffer. A buffer hit turns the miss the
+  // level just counted into a hit; a block still in flight stays a miss.
+  void note_late_prefetch() { ++stats.late_prefetches; }
+  void note_buffer_fill() { ++stats.prefetch_fills; }
+  void note_buffer_hit() {
+    --stats.misses;
+    ++stats.hits;
+    ++stats.useful_prefetches;
+  }
+
+  // Switches to an access path compiled for this level's associativity and
+  // policy (1, 2, 4, 8 or 16 ways with FIFO, LRU or LFU). Other
+  // configurations keep the generic path and return false.
+  bool specialize();
+  bool is_specialized() const;
+
+  // With classify_misses, the copy carries the reuse-distance histogram.
+  CacheStats get_stats() const;
   const CacheConfig &get_config() const { return config; }
+  size_t get_num_sets() const { return num_sets; }
 
   void reset();
 
 private:
-  struct CacheLine {
-    bool valid;
-    size_t tag;
-    size_t last_access_time;
-    size_t insert_time;
-    size_t frequency;
-
-    CacheLine()
-        : valid(false), tag(0), last_access_time(0), insert_time(0),
-          frequency(0) {}
-  };
+  typedef bool (CacheLevel::*AccessPath)(size_t, AccessType, CacheSpill &);
+
+  // Ways value of the generic path: geometry and policy come from config.
+  static const size_t ANY_WAYS = 0;
+
+  // RRIP insertion values and the BRRIP long-insertion rate (1 in 32).
+  static const uint64_t RRPV_DISTANT = 3;
+  static const uint64_t RRPV_LONG = 2;
+  static const size_t BRRIP_THROTTLE = 32;
 
   CacheConfig config;
   CacheStats stats;
 
   size_t num_sets;
+  size_t num_ways;
+
+  // Power-of-two block size and set count: the set index and tag come from
+  // shifts and a mask instead of a division and a modulo.
+  bool pow2_geometry;
+  unsigned block_shift;
+  unsigned set_shift;
+  size_t set_mask;
+
+  size_t mask_words;
   size_t global_time;
+  AccessPath access_path;
+
+  // Structure-of-arrays line storage. Way w of set s lives at index
+  // s * num_ways + w of tags and policy_state; set s owns mask_words 64-bit
+  // words of valid_masks starting at s * mask_words.
+  vector<uint64_t> tags;
+  vector<uint64_t> valid_masks;
+  vector<uint64_t> dirty_masks;
+  // Insert time (FIFO), last access time (LRU) or access count (LFU);
+  // empty for the other policies.
+  vector<uint64_t> policy_state;
+  // Packed per-set metadata of the compact policies, policy_words words per
+  // set: PLRU tree or MRU bits, or 2-bit RRPVs (32 ways per word).
+  size_t policy_words;
+  vector<uint64_t> policy_bits;
+  uint64_t random_state;
+  size_t brrip_fills;
+  size_t dirty_lines;
+
+  // Prefetched lines not yet used by a demand access, laid out like
+  // valid_masks, and the blocks prefetch fills evicted. While nothing is
+  // prefetched the demand paths skip both.
+  vector<uint64_t> prefetch_masks;
+  size_t prefetched_lines;
+  unordered_set<size_t> polluted;
+  bool prefetch_hit;
 
-  vector<vector<CacheLine>> sets;
+  // Shadow LRU stack over all lines of the level (one set, holding as many
+  // blocks as the level has lines), enabled by classify_misses, and the
+  // hashed first-touch bitmap beside it.
+  StackDistanceProfiler shadow;
+  vector<uint64_t> first_touch;
+  static const size_t FIRST_TOUCH_LOG2 = 22;
 
   size_t get_set_index(size_t address) const;
   size_t get_tag(size_t address) const;
 
   int find_line_with_tag(size_t set_index, size_t tag) const;
   int select_victim_line(size_t set_index);
+  void on_hit(size_t set_index, size_t way, ReplacementPolicy policy);
+  void on_fill(size_t set_index, size_t way, ReplacementPolicy policy);
+
+  // Compact policies (replacement.cpp).
+  void init_policy_metadata();
+  void tree_plru_touch(size_t set_index, size_t way);
+  size_t tree_plru_victim(size_t set_index) const;
+  void bit_plru_touch(size_t set_index, size_t way);
+  size_t bit_plru_victim(size_t set_index) const;
+  void rrip_set(size_t set_index, size_t way, uint64_t rrpv);
+  size_t rrip_victim(size_t set_index);
+  size_t random_victim();
+
+  template <size_t Ways> int find_way(size_t set_index, size_t tag) const;
+  template <size_t Ways> int select_victim_way(size_t set_index) const;
+  size_t fill_line(size_t set_index, size_t way, size_t tag,
+                   ReplacementPolicy policy, CacheSpill &spill);
+  // Fills a block that is not present outside any demand access; returns
+  // its way, or -1 when it was already there.
+  int fill_absent(size_t address, CacheSpill &spill);
+  void drop_line(size_t set_index, size_t way);
+  bool is_dirty(size_t set_index, size_t way) const;
+  void mark_dirty(size_t set_index, size_t way);
+  void use_prefetched(size_t set_index, size_t way);
+  void check_pollution(size_t address);
+  void classify(size_t address, bool hit);
+  bool touch_first(size_t block);
+
+  template <size_t Ways, ReplacementPolicy Policy>
+  bool access_with(size_t address, AccessType type, CacheSpill &spill);
+  template <ReplacementPolicy Policy> static AccessPath fixed_path(size_t ways);
 };
 
 class CacheHierarchy {
 public:
+  // access() result for a block outside the sampled sets.
+  static const int NOT_SAMPLED = -3;
+
   CacheHierarchy();
+  ~CacheHierarchy();
 
-  void set_levels(const vector<CacheConfig> &level_configs);
-  int access(size_t address);
+  void set_levels(const vector<CacheConfig> &level_configs,
+                  InclusionPolicy inclusion = InclusionPolicy::NINE);
+  // Simulates only the blocks of a hashed fraction of the sets from now on
+  // (sampling.h). Needs one block size and set counts with a common factor.
+  bool set_sampling(double fraction);
+  const SetSampler &get_sampler() const { return sampler; }
+  InclusionPolicy get_inclusion() const { return inclusion; }
+  // translation_cycles: the vm_access page walk that produced address.
+  int access(size_t address, AccessType type = AccessType::READ,
+             uint64_t translation_cycles = 0);
   vector<CacheStats> get_stats() const;
+  const LatencyStats &get_latency() const { return latency.get_stats(); }
   void reset();
   bool empty() const { return levels.empty(); }
+  size_t num_levels() const { return levels.size(); }
+  const CacheConfig &get_config(size_t level) const {
+    return levels[level].get_config();
+  }
 
 private:
+  struct PendingWrite {
+    size_t level;
+    size_t address;
+    size_t bytes;
+
+    PendingWrite(size_t l, size_t a, size_t b) : level(l), address(a), bytes(b) {}
+  };
+
   vector<CacheLevel> levels;
+  InclusionPolicy inclusion;
+  vector<PendingWrite> pending_writes;
+  // Per level: its prefetcher (or null) and the blocks requested by the
+  // previous access to it, which arrive after the next one looks up.
+  vector<Prefetcher *> prefetchers;
+  vector<vector<size_t>> in_flight;
+  vector<size_t> requests;
+  LatencyModel latency;
+  SetSampler sampler;
+
+  int access_levels(size_t address, AccessType type);
+  int access_exclusive(size_t address, AccessType type);
+  void write_down(size_t level, size_t address, size_t bytes);
+  void move_victim_down(size_t level, const CacheSpill &spill);
+  void back_invalidate(size_t level, size_t address);
+  void install_below(size_t level, size_t address);
+  bool run_prefetcher(size_t level, size_t address, bool hit);
+  void clear_prefetchers();
+
+  CacheHierarchy(const CacheHierarchy &);
+  CacheHierarchy &operator=(const CacheHierarchy &);
 };
 
 #endif
@@ -0,0 +1,94 @@
+#ifndef CACHE_SWEEP_H
+#define CACHE_SWEEP_H
+
+#include "cache.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Runs one trace through many single-level caches at once. The reader
+// decodes each access once into a batch; when the batch is full it is
+// handed to the workers and the reader fills the other batch meanwhile.
+// Each worker owns every threads-th configuration and walks the batch in
+// chunks small enough to stay in L1, running every one of its levels over
+// a chunk before moving on, so the trace is read from memory once per
+// worker instead of once per configuration.
+class CacheSweep {
+public:
+  CacheSweep();
+  ~CacheSweep();
+
+  // Configurations the CacheLevel constructor rejects are left out of the
+  // sweep and counted in skipped. Returns false when none is left.
+  bool start(const vector<CacheConfig> &configs, size_t threads,
+             size_t &skipped);
+  void stop();
+  bool active() const { return !configs.empty(); }
+  size_t size() const { return configs.size(); }
+  size_t num_workers() const { return workers.size(); }
+  const CacheConfig &get_config(size_t i) const { return configs[i]; }
+
+  void access(size_t address, AccessType type,
+              uint64_t translation_cycles = 0) {
+    batches[filling].push_back(SweepAccess(address, translation_cycles, type));
+    if (batches[filling].size() >= BATCH) {
+      publish();
+    }
+  }
+
+  // Both wait until every access so far has been simulated; in start's
+  // configuration order.
+  vector<CacheStats> get_stats();
+  vector<LatencyStats> get_latency();
+
+private:
+  static const size_t BATCH = 4096;
+  static const size_t CHUNK = 256;
+
+  struct SweepAccess {
+    uint64_t address;
+    uint64_t translation_cycles;
+    AccessType type;
+
+    SweepAccess(uint64_t a = 0, uint64_t c = 0,
+                AccessType t = AccessType::READ)
+        : address(a), translation_cycles(c), type(t) {}
+  };
+
+  struct Worker {
+    vector<size_t> index; // positions in configs
+    vector<CacheLevel> levels;
+    vector<LatencyModel> latency;
+    thread runner;
+  };
+
+  vector<CacheConfig> configs;
+  vector<Worker *> workers;
+  vector<SweepAccess> batches[2];
+  size_t filling;
+
+  // Hand-off: the batch the workers run, bumped generation per batch, and
+  // the workers still on it.
+  mutex lock;
+  condition_variable work_ready;
+  condition_variable work_done;
+  const vector<SweepAccess> *current;
+  uint64_t generation;
+  size_t busy;
+  bool stopping;
+
+  void publish();
+  void wait_idle();
+  void run(Worker *worker);
+  static void simulate(Worker &worker, const vector<SweepAccess> &batch);
+
+  CacheSweep(const CacheSweep &);
+  CacheSweep &operator=(const CacheSweep &);
+};
+
+#endif
@@ -4,7 +4,13 @@
 #include "allocator.h"
 #include "buddy.h"
 #include "cache.h"
+#include "cache_sweep.h"
+#include "coherence.h"
+#include "events.h"
+#include "parallel_cache.h"
+#include "stack_distance.h"
 #include "vm.h"
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -22,9 +28,12 @@ enum class CommandType {
   CACHE_INIT,
   CACHE_ACCESS,
   CACHE_STATS,
+  CACHE_SWEEP,
   VM_INIT,
   VM_ACCESS,
   VM_STATS,
+  PROFILE_INIT,
+  PROFILE_STATS,
   HELP
 };
 
@@ -52,31 +61,69 @@ public:
   void run();
   void execute_command(const Command &cmd);
 
+  // Batch mode drops the banner and prompt for replaying traces; per-op
+  // events go to the configured sink (default: none in batch, console
+  // otherwise) and only stats commands print summaries.
+  void set_batch_mode(bool enabled) { batch_mode = enabled; }
+  bool set_event_sink(EventSinkType type, const string &output_path = "");
+  // With two or more threads and no per-op events, single-core hierarchies
+  // run on ParallelCacheSim workers; cache sweeps always use them.
+  void set_cache_threads(size_t threads) { cache_threads = threads; }
+
+  // Replays a binary trace (see trace.h) straight into the engines.
+  bool replay(const string &path);
+
 private:
+  bool batch_mode;
+  bool event_sink_set;
+  bool events_enabled;
+  EventSink *events;
+  ofstream event_file;
+
   MemoryAllocator *allocator;
   BuddyAllocator *buddy_allocator;
   bool use_buddy;
+  bool use_boundary_tags;
   bool initialized;
 
   CacheHierarchy cache_hierarchy;
   bool cache_initialized;
+  // With more than one core, accesses go to coherent_hierarchy instead.
+  CoherentHierarchy coherent_hierarchy;
+  size_t cache_cores;
+  // While active, holds the single-core hierarchy's state instead of
+  // cache_hierarchy.
+  ParallelCacheSim parallel_cache;
+  size_t cache_threads;
+  // While active, takes every access instead of the hierarchies.
+  CacheSweep cache_sweep;
+  StackDistanceProfiler stack_profiler;
 
   VirtualMemoryManager vm_manager;
   bool vm_initialized;
 
   void handle_init(const vector<string> &args);
   void handle_set_allocator(const vector<string> &args);
+  void handle_set_boundary_tags(const string &value);
   void handle_malloc(const vector<string> &args);
   void handle_free(const vector<string> &args);
+  void run_malloc(size_t size);
+  void run_free(size_t block_id);
   void handle_dump();
   void handle_stats();
 
   void handle_cache_init(const vector<string> &args);
   void handle_cache_access(const vector<string> &args);
+  void run_cache_access(size_t address, AccessType type = AccessType::READ,
+                        size_t core = 0);
   void handle_cache_stats();
+  void handle_cache_sweep(const vector<string> &args);
+  void handle_profile_init(const vector<string> &args);
+  void handle_profile_stats(const vector<string> &args);
 
   void handle_vm_init(const vector<string> &args);
   void handle_vm_access(const vector<string> &args);
+  void run_vm_access(size_t vaddr);
   void handle_vm_stats();
 };
 
@@ -0,0 +1,144 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include "cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+struct CoherenceStats {
+  uint64_t coherence_misses;       // refetches of a block another core took
+  uint64_t invalidations_sent;     // copies this core's writes removed
+  uint64_t invalidations_received; // copies other cores' writes removed
+  uint64_t false_sharing;          // ... where this core never used the word
+  uint64_t cache_to_cache;         // misses served from another core's line
+  uint64_t upgrades;               // writes to a shared line this core held
+
+  CoherenceStats()
+      : coherence_misses(0), invalidations_sent(0), invalidations_received(0),
+        false_sharing(0), cache_to_cache(0), upgrades(0) {}
+};
+
+// A block that lost copies to coherence, for spotting sharing hot spots.
+struct SharingHotspot {
+  size_t address;
+  uint64_t invalidations;
+  uint64_t false_sharing;
+
+  SharingHotspot(size_t a = 0, uint64_t inv = 0, uint64_t fs = 0)
+      : address(a), invalidations(inv), false_sharing(fs) {}
+};
+
+// N cores with private cache levels in front of shared ones, kept coherent
+// with snooping MESI.
+//
+// The state of a line follows from where the block is held: Modified is
+// dirty in one core's private levels, Exclusive is clean in one core, and
+// Shared is clean in several. A write by a core that does not hold the
+// block Modified invalidates every other private copy (BusRdX / upgrade);
+// a private miss snoops the other cores and downgrades a Modified copy to
+// Shared (BusRd). A dirty copy found by either snoop is flushed to the first
+// shared level and counts as a cache-to-cache transfer, which serves the
+// miss without a shared-level demand access.
+//
+// Every level must use the same block size, so a block is the coherence
+// unit. An invalidation counts as false sharing when the losing core never
+// touched the written word of the block while it held it.
+//
+// Each core's latency follows its own chain; a cache-to-cache transfer
+// costs as much as a hit in the first shared level.
+class CoherentHierarchy {
+public:
+  // Hit level returned when another core supplied the block.
+  static const int REMOTE_HIT = -2;
+  static const size_t HOTSPOT_SLOTS = 256;
+
+  CoherentHierarchy();
+
+  // private_configs are instantiated once per core, shared_configs once.
+  void set_levels(size_t cores, const vector<CacheConfig> &private_configs,
+                  const vector<CacheConfig> &shared_configs);
+  int access(size_t core, size_t address, AccessType type = AccessType::READ,
+             uint64_t translation_cycles = 0);
+
+  size_t num_cores() const { return cores.size(); }
+  size_t num_private_levels() const { return private_levels; }
+  size_t num_levels() const { return private_levels + shared.size(); }
+  bool empty() const { return cores.empty(); }
+
+  vector<CacheStats> get_core_stats(size_t core) const;
+  vector<CacheStats> get_shared_stats() const;
+  const CoherenceStats &get_coherence_stats(size_t core) const {
+    return cores[core].coherence;
+  }
+  const LatencyStats &get_latency(size_t core) const {
+    return cores[core].latency.get_stats();
+  }
+  // The blocks with the most invalidations, most first. Only the
+  // HOTSPOT_SLOTS hottest blocks are tracked: a block that enters a full
+  // table takes the coldest one's place and starts from its invalidation
+  // count (space-saving), so its count may be over by up to that much.
+  vector<SharingHotspot> hottest_blocks(size_t count) const;
+
+  void reset();
+
+private:
+  struct Core {
+    vector<CacheLevel> levels;
+    CoherenceStats coherence;
+    LatencyModel latency;
+    // Words touched in each block since it was fetched, one bit per word;
+    // dropped once no private level holds the block.
+    unordered_map<size_t, uint64_t> touched;
+    // Blocks another core's write invalidated and not refetched since, with
+    // their slot in lost_order. Only as many are remembered as the private
+    // levels have lines; the oldest is forgotten first, as its line would
+    // have been reused by then.
+    unordered_map<size_t, size_t> lost;
+    vector<size_t> lost_order;
+    size_t lost_next;
+
+    Core() : lost_next(0) {}
+  };
+
+  struct PendingWrite {
+    size_t level;
+    size_t address;
+    size_t bytes;
+
+    PendingWrite(size_t l, size_t a, size_t b) : level(l), address(a), bytes(b) {}
+  };
+
+  vector<Core> cores;
+  vector<CacheLevel> shared;
+  size_t private_levels;
+  size_t block_size;
+  // Per core: its private levels, then the shared ones.
+  vector<vector<CacheLevel *>> chains;
+  vector<PendingWrite> pending_writes;
+  // Blocks that left a private level during the current access.
+  vector<size_t> departed;
+  unordered_map<size_t, SharingHotspot> hotspots;
+  // (invalidations, address) of every tracked hot spot, coldest first.
+  set<pair<uint64_t, size_t>> hotspot_order;
+
+  uint64_t word_bit(size_t address) const;
+  bool holds_modified(const Core &core, size_t address) const;
+  bool holds(const Core &core, size_t address) const;
+  bool invalidate_others(size_t core, size_t address);
+  bool downgrade_others(size_t core, size_t address);
+  void mark_lost(Core &core, size_t block);
+  void forget_departed(Core &core);
+  void count_hotspot(size_t block, bool false_sharing);
+  void write_down(size_t core, size_t level, size_t address, size_t bytes);
+
+  CoherentHierarchy(const CoherentHierarchy &);
+  CoherentHierarchy &operator=(const CoherentHierarchy &);
+};
+
+#endif
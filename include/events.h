@@ -0,0 +1,98 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+enum class EventKind : uint8_t {
+  ALLOC,
+  ALLOC_FAIL,
+  FREE,
+  CACHE_ACCESS,
+  VM_ACCESS
+};
+
+const uint8_t EVENT_FLAG_BUDDY = 1 << 0;
+const uint8_t EVENT_FLAG_PAGE_FAULT = 1 << 1;
+const uint8_t EVENT_FLAG_WRITE = 1 << 2;
+const uint8_t EVENT_FLAG_CORE = 1 << 3;
+
+// One simulator operation. Field meaning depends on kind:
+//   ALLOC        a=block id, b=address, c=requested size, d=actual size
+//   ALLOC_FAIL   c=requested size
+//   FREE         a=block id
+//   CACHE_ACCESS a=address, level=hit level (-1 = memory), d=number of levels;
+//                with EVENT_FLAG_CORE, c=core, b=private levels and level -2
+//                means another core's cache supplied the block
+//   VM_ACCESS    a=virtual address, b=physical address, c=page, d=frame
+struct SimEvent {
+  EventKind kind;
+  uint8_t flags;
+  int8_t level;
+  uint64_t a;
+  uint64_t b;
+  uint64_t c;
+  uint64_t d;
+
+  explicit SimEvent(EventKind k = EventKind::ALLOC)
+      : kind(k), flags(0), level(-1), a(0), b(0), c(0), d(0) {}
+};
+
+enum class EventSinkType { CONSOLE, NONE, TEXT, BINARY };
+
+bool parse_event_sink_type(const string &name, EventSinkType &type);
+
+class EventSink {
+public:
+  virtual ~EventSink() {}
+  virtual void emit(const SimEvent &event) = 0;
+  virtual void flush() {}
+};
+
+// Interactive output: one human-readable line per operation, flushed.
+class ConsoleSink : public EventSink {
+public:
+  explicit ConsoleSink(ostream &out) : out(out) {}
+  void emit(const SimEvent &event) override;
+
+private:
+  ostream &out;
+};
+
+class NullSink : public EventSink {
+public:
+  void emit(const SimEvent &) override {}
+};
+
+// Compact one-line-per-event text; relies on the stream's buffering and
+// only flushes on request.
+class TextSink : public EventSink {
+public:
+  explicit TextSink(ostream &out) : out(out) {}
+  void emit(const SimEvent &event) override;
+  void flush() override { out.flush(); }
+
+private:
+  ostream &out;
+};
+
+// An 8-byte "MNEVENT1" header, then one 36-byte record per event: kind,
+// flags, level and a zero pad byte, followed by a, b, c, d as little-endian
+// uint64.
+class BinarySink : public EventSink {
+public:
+  explicit BinarySink(ostream &out);
+  void emit(const SimEvent &event) override;
+  void flush() override { out.flush(); }
+
+private:
+  ostream &out;
+};
+
+EventSink *make_event_sink(EventSinkType type, ostream &out);
+
+#endif
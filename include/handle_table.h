@@ -0,0 +1,132 @@
+#ifndef HANDLE_TABLE_H
+#define HANDLE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Generational slot table mapping block IDs to live objects.
+//
+// A handle is slot + 1 + generation * max_slots, so handle 0 is never valid
+// and the first use of each slot yields the IDs 1, 2, 3, ... Freed slots are
+// recycled LIFO with their generation bumped, which makes any handle still
+// naming the old occupant stale. Each reuse adds max_slots to the ID, so
+// reused IDs are only short when max_slots is small (a small heap); on a
+// large heap they jump by millions. max_slots is capped at 2^32, and a slot
+// whose next generation would overflow the handle is retired instead of
+// recycled. Memory grows with the peak number of live entries, not with the
+// number of insertions.
+template <typename T> class HandleTable {
+public:
+  HandleTable() : free_head(NO_SLOT), live(0) {
+    set_max_slots(DEFAULT_MAX_SLOTS);
+  }
+
+  // Set while the table is empty; more than max live entries is not allowed.
+  void set_max_slots(size_t max) {
+    max_slots = max > 0 ? max : 1;
+    if (max_slots > DEFAULT_MAX_SLOTS) {
+      max_slots = DEFAULT_MAX_SLOTS;
+    }
+    // The largest handle of generation g is (g + 1) * max_slots.
+    size_t limit = SIZE_MAX / max_slots - 1;
+    max_generation = limit < UINT32_MAX ? static_cast<uint32_t>(limit)
+                                        : UINT32_MAX;
+  }
+
+  size_t insert(T *value) {
+    uint32_t index;
+    if (free_head != NO_SLOT) {
+      index = free_head;
+      free_head = slots[index].next_free;
+    } else {
+      index = static_cast<uint32_t>(slots.size());
+      slots.push_back(Slot());
+    }
+
+    Slot &slot = slots[index];
+    slot.value = value;
+    slot.next_free = NO_SLOT;
+    live++;
+    return make_handle(index, slot.generation);
+  }
+
+  T *lookup(size_t handle) const {
+    const Slot *slot = resolve(handle);
+    return slot ? slot->value : nullptr;
+  }
+
+  bool erase(size_t handle) {
+    Slot *slot = const_cast<Slot *>(resolve(handle));
+    if (!slot) {
+      return false;
+    }
+
+    uint32_t index = static_cast<uint32_t>(slot - &slots[0]);
+    slot->value = nullptr;
+    live--;
+    if (slot->generation == max_generation) {
+      // Out of IDs: the slot stays empty for good.
+      return true;
+    }
+    slot->generation++;
+    slot->next_free = free_head;
+    free_head = index;
+    return true;
+  }
+
+  // Calls f(handle, value) for every live entry, in slot order.
+  template <typename F> void for_each(F f) const {
+    for (size_t i = 0; i < slots.size(); i++) {
+      if (slots[i].value) {
+        f(make_handle(static_cast<uint32_t>(i), slots[i].generation),
+          slots[i].value);
+      }
+    }
+  }
+
+  size_t size() const { return live; }
+  size_t capacity() const { return slots.size(); }
+  size_t footprint_bytes() const { return slots.capacity() * sizeof(Slot); }
+
+private:
+  static const uint32_t NO_SLOT = UINT32_MAX;
+  static const size_t DEFAULT_MAX_SLOTS = static_cast<size_t>(1) << 32;
+
+  struct Slot {
+    T *value;
+    uint32_t generation;
+    uint32_t next_free;
+
+    Slot() : value(nullptr), generation(0), next_free(NO_SLOT) {}
+  };
+
+  vector<Slot> slots;
+  size_t max_slots;
+  uint32_t max_generation;
+  uint32_t free_head;
+  size_t live;
+
+  size_t make_handle(uint32_t index, uint32_t generation) const {
+    return index + 1 + generation * max_slots;
+  }
+
+  const Slot *resolve(size_t handle) const {
+    if (handle == 0) {
+      return nullptr;
+    }
+    size_t index = (handle - 1) % max_slots;
+    if (index >= slots.size()) {
+      return nullptr;
+    }
+    const Slot &slot = slots[index];
+    if (!slot.value || slot.generation != (handle - 1) / max_slots) {
+      return nullptr;
+    }
+    return &slot;
+  }
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef PARALLEL_CACHE_H
+#define PARALLEL_CACHE_H
+
+#include "cache.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Replays a single-core hierarchy on worker threads, fed by the thread that
+// reads the trace. Results match CacheHierarchy exactly.
+//
+// One level: sets are independent, so the level is split by set index into
+// shards (set % shards), each a CacheLevel with num_sets / shards sets on
+// its own thread. An address is rewritten so the shard sees the same tag
+// in set / shards. Random and BRRIP replacement draw from per-level state
+// shared by all sets, and miss classification needs the whole level's
+// shadow LRU, so those keep one shard.
+//
+// Several levels: one thread per level, as a pipeline. Each stage sends the
+// next its demand misses, then the writebacks that reached it, and an end
+// marker, after which the next stage sends on its own spills. That is the
+// order CacheHierarchy applies them in. Only NINE hierarchies without
+// prefetchers qualify: inclusion and prefetch fills act on levels above.
+class ParallelCacheSim {
+public:
+  ParallelCacheSim();
+  ~ParallelCacheSim();
+
+  // Returns false, and starts nothing, when the hierarchy cannot be
+  // simulated in parallel or threads < 2.
+  bool start(const vector<CacheConfig> &configs, InclusionPolicy inclusion,
+             size_t threads);
+  void stop();
+  bool active() const { return !workers.empty(); }
+  bool sharded() const { return shard_count > 0; }
+  size_t num_workers() const { return workers.size(); }
+
+  void access(size_t address, AccessType type,
+              uint64_t translation_cycles = 0);
+
+  // Both wait until every queued access has been simulated.
+  vector<CacheStats> get_stats();
+  LatencyStats get_latency();
+
+private:
+  enum OpKind : uint8_t { OP_READ, OP_WRITE, OP_WRITEBACK, OP_END };
+
+  // value: translation cycles of a demand access, bytes of a writeback.
+  struct Op {
+    uint64_t address;
+    uint64_t value;
+    OpKind kind;
+
+    Op(uint64_t a = 0, uint64_t v = 0, OpKind k = OP_READ)
+        : address(a), value(v), kind(k) {}
+  };
+
+  static const size_t BATCH = 1024;
+  static const size_t QUEUE_SIZE = 1 << 16;
+
+  struct Worker {
+    CacheLevel level;
+    LatencyModel latency;
+    int stage;    // level index for latency; 0 for shards
+    Worker *next; // pipeline successor, or null
+    SpscQueue<Op> input;
+    vector<Op> inbox;    // the reader's ops for this worker, not yet sent
+    vector<Op> outbox;   // this worker's ops for next, not yet sent
+    vector<Op> deferred; // this access's own spills, sent after END
+    bool forwarded;      // the current access's demand went to next
+    atomic<uint64_t> received;
+    atomic<uint64_t> processed;
+    atomic<bool> stopping;
+    thread runner;
+
+    Worker(const CacheConfig &config, int stage)
+        : level(config), stage(stage), next(nullptr), input(QUEUE_SIZE),
+          forwarded(false), received(0), processed(0), stopping(false) {}
+  };
+
+  vector<Worker *> workers;
+  // Sharded mode (shard_count > 0): the whole level's geometry, and shifts
+  // for routing when block size, set count and shard count are powers of 2.
+  size_t shard_count;
+  size_t num_sets;
+  size_t block_size;
+  bool pow2_shards;
+  unsigned block_shift;
+  unsigned set_shift;
+  unsigned shard_shift;
+
+  static void run(Worker *worker);
+  static void apply(Worker &worker, const Op &op);
+  static void finish_access(Worker &worker);
+  static void send(Worker &to, vector<Op> &ops);
+  void sync();
+
+  ParallelCacheSim(const ParallelCacheSim &);
+  ParallelCacheSim &operator=(const ParallelCacheSim &);
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Fixed-size slot allocator for simulator metadata. Slots are carved from
+// slabs of slots_per_slab entries; freed slots go on an intrusive free list
+// and are handed out again before a new slab is requested from the host.
+// Slabs are only returned to the host when the pool is destroyed.
+class SlabPool {
+public:
+  explicit SlabPool(size_t slot_size = 0, size_t slots_per_slab = 256);
+  ~SlabPool();
+
+  void *allocate();
+  void deallocate(void *slot);
+
+  // A pool created with slot_size 0 takes the size of its first user.
+  size_t get_slot_size() const { return slot_size; }
+  void set_slot_size(size_t size);
+
+  size_t in_use() const { return live_slots; }
+  size_t capacity() const { return slabs.size() * slots_per_slab; }
+  size_t num_slabs() const { return slabs.size(); }
+  size_t footprint_bytes() const { return capacity() * slot_size; }
+
+private:
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+
+  vector<char *> slabs;
+  FreeSlot *free_slots;
+  size_t slot_size;
+  size_t slots_per_slab;
+  size_t live_slots;
+
+  void grow();
+
+  SlabPool(const SlabPool &);
+  SlabPool &operator=(const SlabPool &);
+};
+
+template <typename T> class ObjectPool {
+public:
+  explicit ObjectPool(size_t slots_per_slab = 256)
+      : slots(sizeof(T), slots_per_slab) {}
+
+  template <typename... Args> T *create(Args &&...args) {
+    return new (slots.allocate()) T(std::forward<Args>(args)...);
+  }
+
+  void destroy(T *obj) {
+    obj->~T();
+    slots.deallocate(obj);
+  }
+
+  const SlabPool &get_slab_pool() const { return slots; }
+
+private:
+  SlabPool slots;
+};
+
+// Standard allocator that serves single-object requests (container nodes)
+// from a SlabPool and anything else from the host heap.
+template <typename T> class PoolAllocator {
+public:
+  typedef T value_type;
+
+  explicit PoolAllocator(SlabPool *p) : pool(p) {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &other) : pool(other.pool) {}
+
+  T *allocate(size_t n) {
+    if (n == 1 && fits_pool()) {
+      return static_cast<T *>(pool->allocate());
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, size_t n) {
+    if (n == 1 && fits_pool()) {
+      pool->deallocate(p);
+    } else {
+      ::operator delete(p);
+    }
+  }
+
+  template <typename U> bool operator==(const PoolAllocator<U> &o) const {
+    return pool == o.pool;
+  }
+  template <typename U> bool operator!=(const PoolAllocator<U> &o) const {
+    return pool != o.pool;
+  }
+
+  SlabPool *pool;
+
+private:
+  bool fits_pool() const {
+    if (pool->get_slot_size() == 0) {
+      pool->set_slot_size(sizeof(T));
+    }
+    return sizeof(T) <= pool->get_slot_size();
+  }
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+// A prefetcher watches the demand accesses of one cache level and names
+// blocks (block numbers, address / block_size) to bring in. The hierarchy
+// owns the timing: requests made on one access arrive after the next
+// access to the level has looked up, so a demand miss in between finds the
+// prefetch late.
+class Prefetcher {
+public:
+  explicit Prefetcher(const PrefetchConfig &config) : config(config) {}
+  virtual ~Prefetcher() {}
+
+  // first_use is a hit on a line a prefetch brought in.
+  virtual void observe(size_t block, bool hit, bool first_use,
+                       vector<size_t> &requests) = 0;
+
+  // Stream buffers keep their lines beside the cache instead of filling it.
+  virtual bool buffers_lines() const { return false; }
+  // Removes block from the buffers; true when one of them held it.
+  virtual bool take(size_t) { return false; }
+
+  virtual void reset() {}
+
+  const PrefetchConfig &get_config() const { return config; }
+
+protected:
+  PrefetchConfig config;
+};
+
+// Next-line (tagged): a miss, or the first use of a prefetched line, asks
+// for blocks distance .. distance + degree - 1 past it, so a sequential
+// stream keeps running ahead.
+class NextLinePrefetcher : public Prefetcher {
+public:
+  explicit NextLinePrefetcher(const PrefetchConfig &config)
+      : Prefetcher(config) {}
+  void observe(size_t block, bool hit, bool first_use,
+               vector<size_t> &requests) override;
+};
+
+// PC-less stride: a direct-mapped table of 4 KiB regions remembers each
+// region's last block and stride. Once the same non-zero stride is seen
+// twice in a row, every access asks for the blocks distance .. distance +
+// degree - 1 strides ahead.
+class StridePrefetcher : public Prefetcher {
+public:
+  StridePrefetcher(const PrefetchConfig &config, size_t block_size);
+  void observe(size_t block, bool hit, bool first_use,
+               vector<size_t> &requests) override;
+  void reset() override;
+
+private:
+  static const size_t REGION_BYTES = 4096;
+  static const size_t TABLE_ENTRIES = 64;
+  static const int CONFIRMED = 2;
+
+  struct Region {
+    size_t region;
+    size_t last_block;
+    int64_t stride;
+    int confidence;
+    bool valid;
+
+    Region()
+        : region(0), last_block(0), stride(0), confidence(0), valid(false) {}
+  };
+
+  size_t blocks_per_region;
+  vector<Region> table;
+};
+
+// Jouppi stream buffers: STREAM_BUFFERS FIFOs of degree blocks each. A miss
+// that no buffer holds restarts the least recently used buffer at distance
+// blocks past the miss; a miss a buffer holds is served from it, and the
+// buffer tops itself up past its tail. Buffered lines never evict cache
+// lines.
+class StreamBufferPrefetcher : public Prefetcher {
+public:
+  explicit StreamBufferPrefetcher(const PrefetchConfig &config);
+  void observe(size_t block, bool hit, bool first_use,
+               vector<size_t> &requests) override;
+  bool buffers_lines() const override { return true; }
+  bool take(size_t block) override;
+  void reset() override;
+
+private:
+  static const size_t STREAM_BUFFERS = 4;
+
+  struct Stream {
+    deque<size_t> blocks;
+    size_t next_block; // the block after the tail
+    uint64_t last_use;
+
+    Stream() : next_block(0), last_use(0) {}
+  };
+
+  vector<Stream> streams;
+  uint64_t clock;
+  int taken_from; // stream that served the current miss, or -1
+};
+
+// Returns null for PrefetchKind::NONE.
+Prefetcher *make_prefetcher(const PrefetchConfig &config, size_t block_size);
+
+#endif
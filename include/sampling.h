@@ -0,0 +1,77 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Scaled figures for one level of a set-sampled run. hit_ratio and
+// half_width are percentages; half_width is the 95% confidence interval
+// around hit_ratio, or negative when fewer than two units were sampled.
+struct SampledEstimate {
+  double accesses;
+  double hits;
+  double misses;
+  double hit_ratio;
+  double half_width;
+
+  SampledEstimate()
+      : accesses(0), hits(0), misses(0), hit_ratio(0), half_width(-1) {}
+};
+
+// Set sampling: only blocks whose unit was picked are simulated. A unit is
+// block % units, where units divides every level's set count, so a sampled
+// unit owns whole sets in every level and each of them sees all of its
+// traffic. The units are picked once by hashing their index; the filter per
+// access is a table lookup. Each sampled unit counts the accesses and hits
+// of every level, and the estimates treat the units as a cluster sample.
+class SetSampler {
+public:
+  static const int SKIPPED = -1;
+
+  SetSampler();
+
+  // Samples round(fraction * units) units, at least one. Returns false when
+  // the set counts have no common factor above 1.
+  bool init(const vector<size_t> &level_sets, size_t block_size,
+            double fraction);
+  void clear();
+  bool enabled() const { return units > 0; }
+
+  // The access's slot among the sampled units, or SKIPPED.
+  int slot(size_t address) const {
+    size_t block = pow2_units ? address >> block_shift : address / block_size;
+    size_t unit = pow2_units ? block & (units - 1) : block % units;
+    return slots[unit];
+  }
+  void skip() { ++skipped; }
+  // hit_level as returned by the hierarchy, -1 for memory.
+  void record(int slot, int hit_level);
+
+  size_t num_units() const { return units; }
+  size_t num_sampled() const { return sampled; }
+  uint64_t sampled_accesses() const { return simulated; }
+  uint64_t total_accesses() const { return simulated + skipped; }
+  // Total accesses per simulated one, for scaling counts.
+  double scale() const;
+  SampledEstimate estimate(size_t level) const;
+
+  void reset();
+
+private:
+  size_t units;
+  size_t sampled;
+  size_t levels;
+  size_t block_size;
+  bool pow2_units;
+  unsigned block_shift;
+  vector<int> slots;
+  // Per sampled slot and level: accesses, then hits.
+  vector<uint64_t> counts;
+  uint64_t simulated;
+  uint64_t skipped;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// Bounded lock-free ring for one producer thread and one consumer thread.
+// Each side keeps a private copy of the other side's index and reloads it
+// only when the ring looks full (or empty), so moving a batch costs one
+// acquire load and one release store. Padding keeps the two sides' fields
+// on separate cache lines so the threads do not false-share.
+template <typename T> class SpscQueue {
+public:
+  // capacity is rounded up to a power of two.
+  explicit SpscQueue(size_t capacity)
+      : head(0), cached_tail(0), tail(0), cached_head(0) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    ring.resize(size);
+    mask = size - 1;
+  }
+
+  // Producer side: copies up to count items in and returns how many fit.
+  size_t push(const T *items, size_t count) {
+    size_t t = tail.load(memory_order_relaxed);
+    size_t room = ring.size() - (t - cached_head);
+    if (room < count) {
+      cached_head = head.load(memory_order_acquire);
+      room = ring.size() - (t - cached_head);
+    }
+    size_t n = count < room ? count : room;
+    for (size_t i = 0; i < n; ++i) {
+      ring[(t + i) & mask] = items[i];
+    }
+    tail.store(t + n, memory_order_release);
+    return n;
+  }
+
+  // Consumer side: copies up to max items out and returns how many.
+  size_t pop(T *out, size_t max) {
+    size_t h = head.load(memory_order_relaxed);
+    size_t ready = cached_tail - h;
+    if (ready < max) {
+      cached_tail = tail.load(memory_order_acquire);
+      ready = cached_tail - h;
+    }
+    size_t n = max < ready ? max : ready;
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = ring[(h + i) & mask];
+    }
+    head.store(h + n, memory_order_release);
+    return n;
+  }
+
+private:
+  vector<T> ring;
+  size_t mask;
+
+  char pad_front[64];
+  atomic<size_t> head; // next slot to read; consumer-owned
+  size_t cached_tail;
+  char pad_middle[64];
+  atomic<size_t> tail; // next slot to write; producer-owned
+  size_t cached_head;
+  char pad_back[64];
+
+  SpscQueue(const SpscQueue &);
+  SpscQueue &operator=(const SpscQueue &);
+};
+
+#endif
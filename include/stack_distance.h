@@ -0,0 +1,84 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// One-pass LRU stack-distance (Mattson) profiler.
+//
+// Blocks map to sets exactly as in CacheLevel, and every set keeps its own
+// LRU stack. The stack distance of an access is the number of distinct
+// blocks of the same set touched since the previous access to its block,
+// so an LRU cache with the same block size and set count hits iff
+// distance < ways. One pass therefore gives the hit count of every
+// associativity (num_sets == 1 gives every fully associative capacity).
+//
+// Stacks use the Bennett-Kruskal scheme: each set hands out increasing
+// slots, one per access, and a Fenwick tree marks the slots that hold some
+// block's most recent access. The distance is the number of marked slots
+// after the block's previous one, O(log n) per access. When a set runs out
+// of slots the live ones are renumbered in order, so memory stays
+// proportional to the number of distinct blocks, not the trace length.
+//
+// With max_blocks set, each set keeps at most that many blocks and drops its
+// deepest one to make room, so memory is bounded by the cap instead of the
+// trace footprint. A block dropped that way is COLD again on its next access
+// and its reuse is not in the histogram.
+class StackDistanceProfiler {
+public:
+  // Distance returned for the first access to a block.
+  static const size_t COLD = SIZE_MAX;
+
+  StackDistanceProfiler();
+
+  bool init(size_t block_size, size_t num_sets = 1, size_t max_blocks = 0);
+  bool enabled() const { return block_size != 0; }
+  // Returns the access's stack distance, or COLD.
+  size_t access(size_t address);
+
+  size_t get_block_size() const { return block_size; }
+  size_t get_num_sets() const { return stacks.size(); }
+  uint64_t get_accesses() const { return accesses; }
+  // Accesses to blocks not in the stack: first touches, and with max_blocks
+  // also blocks dropped from it.
+  uint64_t get_cold_misses() const { return cold_misses; }
+
+  // histogram[d] is the number of accesses with stack distance d.
+  const vector<uint64_t> &get_histogram() const { return histogram; }
+  // LRU hits for a cache with this many ways per set.
+  uint64_t hits_with_ways(size_t ways) const;
+
+private:
+  struct SetStack {
+    vector<uint32_t> marks;   // Fenwick tree over slots
+    vector<size_t> owners;    // block in each slot, or NO_BLOCK
+    uint32_t next_slot;
+    uint32_t live;
+
+    SetStack() : next_slot(0), live(0) {}
+  };
+
+  static const size_t NO_BLOCK = SIZE_MAX;
+  static const size_t MIN_SLOTS = 64;
+
+  size_t block_size;
+  size_t max_blocks; // per set, 0 for unbounded
+  uint64_t accesses;
+  uint64_t cold_misses;
+
+  vector<SetStack> stacks;
+  unordered_map<size_t, uint32_t> last_slot;
+  vector<uint64_t> histogram;
+
+  void compact(SetStack &stack);
+  void drop_deepest(SetStack &stack);
+  static void add_mark(vector<uint32_t> &marks, size_t slot, int delta);
+  static uint32_t marks_through(const vector<uint32_t> &marks, size_t slot);
+  static size_t first_mark(const vector<uint32_t> &marks);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Binary trace format: the 8-byte magic "MNTRACE1" followed by records of a
+// one-byte opcode and LEB128 varint operands. The hot operations carry their
+// operand directly; everything else (init, set, cache_init, stats, ...) is
+// kept as a length-prefixed text command and goes through CommandParser.
+const char TRACE_MAGIC[] = "MNTRACE1";
+const size_t TRACE_MAGIC_SIZE = 8;
+
+enum class TraceOp : uint8_t {
+  MALLOC = 1,       // size
+  FREE = 2,         // block id
+  CACHE_ACCESS = 3, // address
+  VM_ACCESS = 4,    // virtual address
+  COMMAND = 5,      // length, bytes
+  EXIT = 6,
+  CACHE_WRITE = 7, // address
+  CACHE_CORE = 8   // core id of the cache records that follow (initially 0)
+};
+
+// Read-only memory-mapped view of a binary trace.
+class TraceReader {
+public:
+  TraceReader();
+  ~TraceReader();
+
+  bool open(const string &path);
+  void close();
+
+  bool at_end() const { return cursor >= end; }
+  bool read_op(TraceOp &op);
+  bool read_varint(uint64_t &value);
+  bool read_bytes(size_t length, const char *&bytes);
+
+private:
+  const unsigned char *base;
+  const unsigned char *cursor;
+  const unsigned char *end;
+  size_t mapped_size;
+
+  TraceReader(const TraceReader &);
+  TraceReader &operator=(const TraceReader &);
+};
+
+// Converts a text workload (the CLI command language) into a binary trace.
+bool convert_text_trace(const string &input_path, const string &output_path);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef VIRTUAL_MEMORY_H
 #define VIRTUAL_MEMORY_H
 
+#include "cache.h"
 #include <cstddef>
 #include <string>
 #include <vector>
@@ -9,6 +10,28 @@ using namespace std;
 
 enum class PageReplacementPolicy { FIFO, LRU };
 
+// Cycle costs of a translation: every access walks the page table, and a
+// fault adds the cost of bringing the page in.
+const size_t DEFAULT_PAGE_WALK_CYCLES = 20;
+const size_t DEFAULT_PAGE_FAULT_CYCLES = 10000;
+
+// TLB levels, L1 first. A TLB is a CacheLevel keyed by virtual page number
+// (one-byte blocks), so it takes any cache replacement policy. hit_cycles
+// is what a lookup in the level costs; L1 is overlapped with the cache
+// access by default, and the L2 TLB costs a few cycles more.
+const size_t DEFAULT_L2_TLB_CYCLES = 7;
+
+struct TLBConfig {
+  size_t entries;
+  size_t ways; // entries: fully associative
+  ReplacementPolicy policy;
+  size_t hit_cycles;
+
+  TLBConfig(size_t e = 0, size_t w = 0,
+            ReplacementPolicy p = ReplacementPolicy::LRU, size_t c = 0)
+      : entries(e), ways(w), policy(p), hit_cycles(c) {}
+};
+
 struct PageTableEntry {
   bool valid;
   size_t frame_index;
@@ -29,11 +52,18 @@ struct VMStats {
   size_t accesses;
   size_t page_hits;
   size_t page_faults;
+  size_t translation_cycles; // TLB lookups, page walks and faults
+  size_t page_walks;         // accesses that missed every TLB
+  size_t walk_cycles;
+  // Per TLB level: its geometry and lookup hits and misses.
+  vector<TLBConfig> tlb_configs;
+  vector<CacheStats> tlbs;
 
   VMStats()
       : virtual_size_bytes(0), physical_size_bytes(0), page_size(0),
         num_virtual_pages(0), num_frames(0), accesses(0), page_hits(0),
-        page_faults(0) {}
+        page_faults(0), translation_cycles(0), page_walks(0),
+        walk_cycles(0) {}
 
   double fault_rate() const {
     return accesses > 0 ? static_cast<double>(page_faults) / accesses * 100.0
@@ -43,6 +73,10 @@ struct VMStats {
     return accesses > 0 ? static_cast<double>(page_hits) / accesses * 100.0
                         : 0.0;
   }
+  double avg_translation_cycles() const {
+    return accesses > 0 ? static_cast<double>(translation_cycles) / accesses
+                        : 0.0;
+  }
 };
 
 struct TranslationResult {
@@ -53,12 +87,14 @@ struct TranslationResult {
   size_t physical_address;
   size_t virtual_page;
   size_t frame_index;
+  size_t cycles;
 
-  string message;
+  const char *message;
 
   TranslationResult()
       : success(false), page_fault(false), virtual_address(0),
-        physical_address(0), virtual_page(0), frame_index(0), message("") {}
+        physical_address(0), virtual_page(0), frame_index(0), cycles(0),
+        message("") {}
 };
 
 class VirtualMemoryManager {
@@ -71,6 +107,14 @@ public:
 
   TranslationResult access(size_t virtual_address);
 
+  void set_costs(size_t walk_cycles, size_t fault_cycles) {
+    page_walk_cycles = walk_cycles;
+    page_fault_cycles = fault_cycles;
+  }
+  // TLB levels for the next init(), which starts them empty; none by
+  // default, and then every access walks the page table.
+  void set_tlbs(const vector<TLBConfig> &configs) { tlb_request = configs; }
+
   VMStats get_stats() const;
 
   void reset();
@@ -86,14 +130,22 @@ private:
   size_t num_frames;
 
   PageReplacementPolicy policy;
+  size_t page_walk_cycles;
+  size_t page_fault_cycles;
 
   vector<PageTableEntry> page_table;
   vector<int> frame_to_vpage;
+  // Filled on every miss; an evicted page is shot down from all of them, so
+  // a TLB hit always finds the page resident. tlb_request waits for init.
+  vector<TLBConfig> tlb_request;
+  vector<TLBConfig> tlb_configs;
+  vector<CacheLevel> tlbs;
 
   size_t global_time;
 
   VMStats stats;
 
+  bool lookup_tlbs(size_t vpage, size_t &cycles);
   size_t choose_victim_frame();
   void load_page_into_frame(size_t vpage, size_t frame_index,
                             bool evict_existing);
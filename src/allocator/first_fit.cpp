@@ -1,11 +1,36 @@
 #include "../../include/allocator.h"
-#include <iomanip>
-#include <iostream>
 
 using namespace std;
-FirstFitAllocator::FirstFitAllocator() { allocator_name = "First Fit"; }
+FirstFitAllocator::FirstFitAllocator()
+    : free_blocks_by_address(FreeBlockByAddress(),
+                             PoolAllocator<MemoryBlock *>(&index_node_pool)) {
+  allocator_name = "First Fit";
+}
+
+void FirstFitAllocator::index_free_block(MemoryBlock *block) {
+  MemoryAllocator::index_free_block(block);
+  if (boundary_tags) {
+    free_blocks_by_address.insert(block);
+  }
+}
+
+void FirstFitAllocator::unindex_free_block(MemoryBlock *block) {
+  MemoryAllocator::unindex_free_block(block);
+  if (boundary_tags) {
+    free_blocks_by_address.erase(block);
+  }
+}
 
 MemoryBlock *FirstFitAllocator::find_free_block(size_t size) {
+  if (boundary_tags) {
+    for (MemoryBlock *block : free_blocks_by_address) {
+      if (block->size >= size) {
+        return block;
+      }
+    }
+    return nullptr;
+  }
+
   MemoryBlock *current = free_list_head;
 
   while (current) {
@@ -23,38 +48,12 @@ AllocationResult FirstFitAllocator::allocate(size_t size) {
     return AllocationResult(false, 0, 0, "Invalid alloc size");
   }
 
-  MemoryBlock *free_block = find_free_block(size);
+  MemoryBlock *free_block = find_free_block(block_size_for(size));
 
   if (!free_block) {
     stats.allocation_failures++;
     return AllocationResult(false, 0, 0, "No suitable bl");
   }
 
-  MemoryBlock *allocated_block;
-
-  if (free_block->size == size) {
-    allocated_block = free_block;
-    remove_from_free_list(free_block);
-    stats.num_free_blocks--;
-  } else {
-    allocated_block = new MemoryBlock(size, free_block->address);
-    free_block->size -= size;
-    free_block->address += size;
-  }
-
-  allocated_block->allocated = true;
-
-  size_t block_id = next_block_id++;
-  allocated_blocks.push_back(allocated_block);
-
-  stats.used_memory += size;
-  stats.free_memory -= size;
-  stats.num_allocations++;
-  stats.num_allocated_blocks++;
-
-  cout << "I[Allocator] Allocated block id=" << block_id << " at address=0x"
-       << hex << setw(4) << setfill('0') << allocated_block->address << dec
-       << " (size=" << size << ")" << endl;
-
-  return AllocationResult(true, block_id, allocated_block->address, "Success");
+  return allocate_from(free_block, size);
 }
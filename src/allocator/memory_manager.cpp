@@ -8,29 +8,16 @@ using namespace std;
 
 MemoryAllocator::MemoryAllocator()
     : memory(nullptr), memory_size(0), free_list_head(nullptr),
-      next_block_id(1), allocator_name("Base") {}
+      free_blocks_by_size(FreeBlockBySize(),
+                          PoolAllocator<MemoryBlock *>(&index_node_pool)),
+      boundary_tags(false),
+      allocator_name("Base") {}
 
 MemoryAllocator::~MemoryAllocator() {
   if (memory) {
     delete[] memory;
   }
-
-  vector<MemoryBlock *> freed_blocks;
-  MemoryBlock *current = free_list_head;
-  while (current) {
-    freed_blocks.push_back(current);
-    current = current->next;
-  }
-
-  for (auto block : allocated_blocks) {
-    if (block && block->allocated) {
-      delete block;
-    }
-  }
-
-  for (auto block : freed_blocks) {
-    delete block;
-  }
+  // Block nodes are released with block_pool.
 }
 
 bool MemoryAllocator::init(size_t size) {
@@ -39,12 +26,25 @@ bool MemoryAllocator::init(size_t size) {
     return false;
   }
 
+  if (boundary_tags) {
+    size -= size % BOUNDARY_TAG_ALIGN;
+    if (size < MIN_TAGGED_BLOCK_SIZE) {
+      cerr << "E[Allocator] Memory too small for boundary tags" << endl;
+      return false;
+    }
+  }
+
   memory_size = size;
+  allocated_blocks.set_max_slots(size / block_size_for(1));
   memory = new char[size];
   memset(memory, 0, size);
 
-  MemoryBlock *initial_block = new MemoryBlock(size, 0);
+  MemoryBlock *initial_block = block_pool.create(size, 0);
   free_list_head = initial_block;
+  index_free_block(initial_block);
+  if (boundary_tags) {
+    write_tags(initial_block);
+  }
 
   stats.total_memory = size;
   stats.free_memory = size;
@@ -55,16 +55,32 @@ bool MemoryAllocator::init(size_t size) {
 }
 
 MemoryBlock *MemoryAllocator::find_block(size_t block_id) {
-  if (block_id == 0 || block_id > allocated_blocks.size()) {
-    return nullptr;
-  }
-  return allocated_blocks[block_id - 1];
+  return allocated_blocks.lookup(block_id);
+}
+
+void MemoryAllocator::index_free_block(MemoryBlock *block) {
+  free_blocks_by_size.insert(block);
+}
+
+void MemoryAllocator::unindex_free_block(MemoryBlock *block) {
+  free_blocks_by_size.erase(block);
 }
 
 void MemoryAllocator::add_to_free_list(MemoryBlock *block) {
   block->allocated = false;
+  index_free_block(block);
 
-  if (!free_list_head || block->address < free_list_head->address) {
+  if (boundary_tags) {
+    // Neighbours are found through the tags, and first fit keeps its own
+    // address index, so the list can stay unordered.
+    block->prev = nullptr;
+    block->next = free_list_head;
+    if (free_list_head) {
+      free_list_head->prev = block;
+    }
+    free_list_head = block;
+    write_tags(block);
+  } else if (!free_list_head || block->address < free_list_head->address) {
     block->next = free_list_head;
     block->prev = nullptr;
     if (free_list_head) {
@@ -87,6 +103,8 @@ void MemoryAllocator::add_to_free_list(MemoryBlock *block) {
 }
 
 void MemoryAllocator::remove_from_free_list(MemoryBlock *block) {
+  unindex_free_block(block);
+
   if (block->prev) {
     block->prev->next = block->next;
   } else {
@@ -101,36 +119,163 @@ void MemoryAllocator::remove_from_free_list(MemoryBlock *block) {
   block->next = nullptr;
 }
 
+size_t MemoryAllocator::block_size_for(size_t size) const {
+  if (!boundary_tags || size > memory_size) {
+    return size;
+  }
+
+  size_t aligned = (size + BOUNDARY_TAG_ALIGN - 1) / BOUNDARY_TAG_ALIGN *
+                   BOUNDARY_TAG_ALIGN;
+  return max(aligned + 2 * BOUNDARY_TAG_SIZE, MIN_TAGGED_BLOCK_SIZE);
+}
+
+void MemoryAllocator::write_tags(MemoryBlock *block) {
+  size_t tag = block->size | (block->allocated ? 1 : 0);
+  memcpy(memory + block->address, &tag, BOUNDARY_TAG_SIZE);
+  memcpy(memory + block->address + block->size - BOUNDARY_TAG_SIZE, &tag,
+         BOUNDARY_TAG_SIZE);
+
+  if (!block->allocated) {
+    memcpy(memory + block->address + BOUNDARY_TAG_SIZE, &block,
+           sizeof(MemoryBlock *));
+  }
+}
+
+size_t MemoryAllocator::read_tag(size_t offset, bool &allocated) const {
+  size_t tag;
+  memcpy(&tag, memory + offset, BOUNDARY_TAG_SIZE);
+  allocated = (tag & 1) != 0;
+  return tag & ~static_cast<size_t>(1);
+}
+
+MemoryBlock *MemoryAllocator::tagged_free_block_at(size_t address) const {
+  MemoryBlock *block;
+  memcpy(&block, memory + address + BOUNDARY_TAG_SIZE, sizeof(MemoryBlock *));
+  return block;
+}
+
+MemoryBlock *MemoryAllocator::split_free_block(MemoryBlock *free_block,
+                                               size_t size) {
+  // A tagged remainder must still fit its own tags and node pointer.
+  size_t min_remainder = boundary_tags ? MIN_TAGGED_BLOCK_SIZE : 1;
+  if (free_block->size - size < min_remainder) {
+    remove_from_free_list(free_block);
+    stats.num_free_blocks--;
+    return free_block;
+  }
+
+  // The remainder keeps its list position, but its index key changes.
+  unindex_free_block(free_block);
+  MemoryBlock *allocated_block = block_pool.create(size, free_block->address);
+  free_block->size -= size;
+  free_block->address += size;
+  index_free_block(free_block);
+  if (boundary_tags) {
+    write_tags(free_block);
+  }
+
+  return allocated_block;
+}
+
+AllocationResult MemoryAllocator::allocate_from(MemoryBlock *free_block,
+                                                size_t size) {
+  MemoryBlock *allocated_block =
+      split_free_block(free_block, block_size_for(size));
+  allocated_block->allocated = true;
+  allocated_block->requested_size = size;
+  if (boundary_tags) {
+    write_tags(allocated_block);
+  }
+
+  size_t block_id = allocated_blocks.insert(allocated_block);
+
+  stats.used_memory += allocated_block->size;
+  stats.free_memory -= allocated_block->size;
+  stats.num_allocations++;
+  stats.num_allocated_blocks++;
+  stats.internal_fragmentation_bytes += allocated_block->size - size;
+
+  size_t address = allocated_block->address;
+  if (boundary_tags) {
+    address += BOUNDARY_TAG_SIZE;
+  }
+
+  return AllocationResult(true, block_id, address, "Success");
+}
+
 MemoryBlock *MemoryAllocator::coalesce(MemoryBlock *block) {
   MemoryBlock *result = block;
 
   if (block->next && block->address + block->size == block->next->address) {
     MemoryBlock *next = block->next;
+    unindex_free_block(block);
+    unindex_free_block(next);
     block->size += next->size;
+    index_free_block(block);
     block->next = next->next;
     if (next->next) {
       next->next->prev = block;
     }
-    delete next;
+    block_pool.destroy(next);
     stats.num_free_blocks--;
   }
 
   if (block->prev &&
       block->prev->address + block->prev->size == block->address) {
     MemoryBlock *prev = block->prev;
+    unindex_free_block(prev);
+    unindex_free_block(block);
     prev->size += block->size;
+    index_free_block(prev);
     prev->next = block->next;
     if (block->next) {
       block->next->prev = prev;
     }
     result = prev;
-    delete block;
+    block_pool.destroy(block);
     stats.num_free_blocks--;
   }
 
   return result;
 }
 
+MemoryBlock *MemoryAllocator::coalesce_tagged(MemoryBlock *block) {
+  MemoryBlock *result = block;
+  bool neighbour_allocated;
+
+  size_t next_address = block->address + block->size;
+  if (next_address < memory_size) {
+    read_tag(next_address, neighbour_allocated);
+    if (!neighbour_allocated) {
+      MemoryBlock *next = tagged_free_block_at(next_address);
+      remove_from_free_list(next);
+      unindex_free_block(block);
+      block->size += next->size;
+      index_free_block(block);
+      block_pool.destroy(next);
+      stats.num_free_blocks--;
+    }
+  }
+
+  if (block->address > 0) {
+    size_t prev_size =
+        read_tag(block->address - BOUNDARY_TAG_SIZE, neighbour_allocated);
+    if (!neighbour_allocated) {
+      MemoryBlock *prev = tagged_free_block_at(block->address - prev_size);
+      remove_from_free_list(block);
+      unindex_free_block(prev);
+      prev->size += block->size;
+      index_free_block(prev);
+      result = prev;
+      block_pool.destroy(block);
+      stats.num_free_blocks--;
+    }
+  }
+
+  write_tags(result);
+  return result;
+}
+
 bool MemoryAllocator::deallocate(size_t block_id) {
   MemoryBlock *block = find_block(block_id);
 
@@ -149,12 +294,16 @@ bool MemoryAllocator::deallocate(size_t block_id) {
   stats.num_deallocations++;
   stats.num_allocated_blocks--;
   stats.num_free_blocks++;
+  stats.internal_fragmentation_bytes -= block->size - block->requested_size;
 
+  allocated_blocks.erase(block_id);
   add_to_free_list(block);
 
-  coalesce(block);
-
-  cout << "I[Deallocator] Block " << block_id << " freed" << endl;
+  if (boundary_tags) {
+    coalesce_tagged(block);
+  } else {
+    coalesce(block);
+  }
 
   update_stats();
   return true;
@@ -162,66 +311,77 @@ bool MemoryAllocator::deallocate(size_t block_id) {
 
 void MemoryAllocator::update_stats() { calculate_fragmentation(); }
 
-void MemoryAllocator::calculate_fragmentation() {
-  size_t largest_free_block = 0;
-  MemoryBlock *current = free_list_head;
-
-  while (current) {
-    if (current->size > largest_free_block) {
-      largest_free_block = current->size;
-    }
-    current = current->next;
+size_t MemoryAllocator::largest_free_block() const {
+  if (free_blocks_by_size.empty()) {
+    return 0;
   }
+  return (*free_blocks_by_size.rbegin())->size;
+}
+
+// Counters are maintained on every split, merge, allocation and free, so
+// this only derives the percentages and does not walk the free list.
+void MemoryAllocator::calculate_fragmentation() {
+  stats.largest_free_block = largest_free_block();
 
   if (stats.free_memory > 0) {
     stats.external_fragmentation =
-        (1.0 - (double)largest_free_block / stats.free_memory) * 100.0;
+        (1.0 - (double)stats.largest_free_block / stats.free_memory) * 100.0;
   } else {
     stats.external_fragmentation = 0.0;
   }
 
-  stats.internal_fragmentation = 0.0;
+  if (stats.used_memory > 0) {
+    stats.internal_fragmentation =
+        (double)stats.internal_fragmentation_bytes / stats.used_memory *
+        100.0;
+  } else {
+    stats.internal_fragmentation = 0.0;
+  }
+
+  stats.tag_overhead_bytes =
+      boundary_tags ? 2 * BOUNDARY_TAG_SIZE *
+                          (stats.num_allocated_blocks + stats.num_free_blocks)
+                    : 0;
 }
 
 AllocationStats MemoryAllocator::get_stats() {
   update_stats();
+  stats.metadata_nodes = block_pool.get_slab_pool().in_use();
+  stats.metadata_pool_bytes = block_pool.get_slab_pool().footprint_bytes() +
+                              index_node_pool.footprint_bytes();
   return stats;
 }
 
 void MemoryAllocator::dump_memory() {
   cout << "\n~~~~~Memory Dump~~~~~~" << endl;
 
-  vector<MemoryBlock *> all_blocks;
+  // (block, id) pairs; free blocks carry id 0.
+  vector<pair<MemoryBlock *, size_t>> all_blocks;
 
   MemoryBlock *free_block = free_list_head;
   while (free_block) {
-    all_blocks.push_back(free_block);
+    all_blocks.push_back(make_pair(free_block, 0));
     free_block = free_block->next;
   }
 
-  for (size_t i = 0; i < allocated_blocks.size(); i++) {
-    if (allocated_blocks[i] && allocated_blocks[i]->allocated) {
-      all_blocks.push_back(allocated_blocks[i]);
-    }
-  }
+  allocated_blocks.for_each([&all_blocks](size_t id, MemoryBlock *block) {
+    all_blocks.push_back(make_pair(block, id));
+  });
 
   sort(all_blocks.begin(), all_blocks.end(),
-       [](MemoryBlock *a, MemoryBlock *b) { return a->address < b->address; });
+       [](const pair<MemoryBlock *, size_t> &a,
+          const pair<MemoryBlock *, size_t> &b) {
+         return a.first->address < b.first->address;
+       });
 
-  for (auto block : all_blocks) {
+  for (auto &entry : all_blocks) {
+    MemoryBlock *block = entry.first;
     cout << "[0x" << hex << setw(4) << setfill('0') << block->address << " - 0x"
          << setw(4) << setfill('0') << (block->address + block->size - 1)
          << "] ";
 
     if (block->allocated) {
-      size_t block_id = 0;
-      for (size_t i = 0; i < allocated_blocks.size(); i++) {
-        if (allocated_blocks[i] == block) {
-          block_id = i + 1;
-          break;
-        }
-      }
-      cout << "I[Allocator] USED (id=" << dec << block_id
+      cout << "I[Allocator] USED (id=" << dec << entry.second
            << ", size=" << block->size << ")";
     } else {
       cout << "I[Allocator] FREE (size=" << dec << block->size << ")";
@@ -0,0 +1,57 @@
+#include "../../include/pool.h"
+
+using namespace std;
+
+static size_t round_slot_size(size_t size) {
+  const size_t align = alignof(max_align_t);
+  if (size < sizeof(void *)) {
+    size = sizeof(void *);
+  }
+  return (size + align - 1) / align * align;
+}
+
+SlabPool::SlabPool(size_t size, size_t per_slab)
+    : free_slots(nullptr), slot_size(size ? round_slot_size(size) : 0),
+      slots_per_slab(per_slab ? per_slab : 1), live_slots(0) {}
+
+SlabPool::~SlabPool() {
+  for (auto slab : slabs) {
+    delete[] slab;
+  }
+}
+
+void SlabPool::set_slot_size(size_t size) {
+  if (slabs.empty()) {
+    slot_size = round_slot_size(size);
+  }
+}
+
+void SlabPool::grow() {
+  char *slab = new char[slot_size * slots_per_slab];
+  slabs.push_back(slab);
+
+  // Thread the new slots onto the free list, lowest address first.
+  for (size_t i = slots_per_slab; i > 0; i--) {
+    FreeSlot *slot = reinterpret_cast<FreeSlot *>(slab + (i - 1) * slot_size);
+    slot->next = free_slots;
+    free_slots = slot;
+  }
+}
+
+void *SlabPool::allocate() {
+  if (!free_slots) {
+    grow();
+  }
+
+  FreeSlot *slot = free_slots;
+  free_slots = slot->next;
+  live_slots++;
+  return slot;
+}
+
+void SlabPool::deallocate(void *p) {
+  FreeSlot *slot = static_cast<FreeSlot *>(p);
+  slot->next = free_slots;
+  free_slots = slot;
+  live_slots--;
+}
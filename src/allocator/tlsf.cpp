@@ -0,0 +1,167 @@
+#include "../../include/allocator.h"
+#include <cstdint>
+
+using namespace std;
+
+static size_t fls_size(size_t n) { return 63 - __builtin_clzll(n); }
+
+TLSFAllocator::TLSFAllocator() : fl_bitmap(0) {
+  allocator_name = "TLSF";
+  boundary_tags = true;
+
+  for (size_t fl = 0; fl < TLSF_FL_INDEX_COUNT; fl++) {
+    sl_bitmap[fl] = 0;
+    for (size_t sl = 0; sl < TLSF_SL_INDEX_COUNT; sl++) {
+      bins[fl][sl] = nullptr;
+    }
+  }
+}
+
+void TLSFAllocator::mapping_insert(size_t size, size_t &fl, size_t &sl) {
+  if (size < TLSF_SMALL_BLOCK_SIZE) {
+    fl = 0;
+    sl = size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_INDEX_COUNT);
+  } else {
+    size_t top = fls_size(size);
+    sl = (size >> (top - TLSF_SL_INDEX_LOG2)) ^ TLSF_SL_INDEX_COUNT;
+    fl = top - (TLSF_FL_INDEX_SHIFT - 1);
+  }
+}
+
+void TLSFAllocator::mapping_search(size_t size, size_t &fl, size_t &sl) {
+  // Round up to the next class so any block in the chosen bin fits.
+  if (size >= TLSF_SMALL_BLOCK_SIZE) {
+    size_t round = (static_cast<size_t>(1)
+                    << (fls_size(size) - TLSF_SL_INDEX_LOG2)) -
+                   1;
+    if (size <= SIZE_MAX - round) {
+      size += round;
+    }
+  }
+  mapping_insert(size, fl, sl);
+}
+
+// Each bin keeps its largest block at the head, so the largest free block
+// overall is the head of the highest non-empty bin. Smaller blocks go in
+// behind the head.
+void TLSFAllocator::index_free_block(MemoryBlock *block) {
+  size_t fl, sl;
+  mapping_insert(block->size, fl, sl);
+
+  MemoryBlock *head = bins[fl][sl];
+  if (head && block->size < head->size) {
+    block->bin_prev = head;
+    block->bin_next = head->bin_next;
+    if (head->bin_next) {
+      head->bin_next->bin_prev = block;
+    }
+    head->bin_next = block;
+  } else {
+    block->bin_prev = nullptr;
+    block->bin_next = head;
+    if (head) {
+      head->bin_prev = block;
+    }
+    bins[fl][sl] = block;
+  }
+
+  fl_bitmap |= static_cast<size_t>(1) << fl;
+  sl_bitmap[fl] |= 1U << sl;
+}
+
+// Allocation never takes a head that has siblings (see find_free_block), so
+// only a merge swallowing a head walks its bin to promote the next largest.
+void TLSFAllocator::unindex_free_block(MemoryBlock *block) {
+  size_t fl, sl;
+  mapping_insert(block->size, fl, sl);
+
+  if (block->bin_prev) {
+    block->bin_prev->bin_next = block->bin_next;
+  } else {
+    bins[fl][sl] = block->bin_next;
+  }
+  if (block->bin_next) {
+    block->bin_next->bin_prev = block->bin_prev;
+  }
+  bool was_head = !block->bin_prev;
+  block->bin_prev = nullptr;
+  block->bin_next = nullptr;
+
+  MemoryBlock *head = bins[fl][sl];
+  if (!head) {
+    sl_bitmap[fl] &= ~(1U << sl);
+    if (!sl_bitmap[fl]) {
+      fl_bitmap &= ~(static_cast<size_t>(1) << fl);
+    }
+    return;
+  }
+
+  if (was_head && head->bin_next) {
+    MemoryBlock *largest = head;
+    for (MemoryBlock *b = head->bin_next; b; b = b->bin_next) {
+      if (b->size > largest->size) {
+        largest = b;
+      }
+    }
+    if (largest != head) {
+      largest->bin_prev->bin_next = largest->bin_next;
+      if (largest->bin_next) {
+        largest->bin_next->bin_prev = largest->bin_prev;
+      }
+      largest->bin_prev = nullptr;
+      largest->bin_next = head;
+      head->bin_prev = largest;
+      bins[fl][sl] = largest;
+    }
+  }
+}
+
+MemoryBlock *TLSFAllocator::find_free_block(size_t size) {
+  size_t fl, sl;
+  mapping_search(size, fl, sl);
+  if (fl >= TLSF_FL_INDEX_COUNT) {
+    return nullptr;
+  }
+
+  unsigned int sl_map = sl_bitmap[fl] & (~0U << sl);
+  if (!sl_map) {
+    size_t fl_map = fl + 1 < TLSF_FL_INDEX_COUNT
+                        ? fl_bitmap & (~static_cast<size_t>(0) << (fl + 1))
+                        : 0;
+    if (!fl_map) {
+      return nullptr;
+    }
+    fl = __builtin_ctzll(fl_map);
+    sl_map = sl_bitmap[fl];
+  }
+  sl = __builtin_ctz(sl_map);
+
+  // Every block in the bin fits; leave the head (the bin's largest) in place
+  // while it has company.
+  MemoryBlock *head = bins[fl][sl];
+  return head->bin_next ? head->bin_next : head;
+}
+
+size_t TLSFAllocator::largest_free_block() const {
+  if (!fl_bitmap) {
+    return 0;
+  }
+  size_t fl = fls_size(fl_bitmap);
+  size_t sl = 31 - __builtin_clz(sl_bitmap[fl]);
+  return bins[fl][sl]->size;
+}
+
+AllocationResult TLSFAllocator::allocate(size_t size) {
+  if (size == 0) {
+    return AllocationResult(false, 0, 0, "Invalid alloc size");
+  }
+
+  MemoryBlock *free_block = find_free_block(block_size_for(size));
+
+  if (!free_block) {
+    stats.allocation_failures++;
+    return AllocationResult(false, 0, 0, "No suitable bl");
+  }
+
+  return allocate_from(free_block, size);
+}
@@ -1,24 +1,21 @@
 #include "../../include/allocator.h"
-#include <iomanip>
-#include <iostream>
 
 using namespace std;
 WorstFitAllocator::WorstFitAllocator() { allocator_name = "Worst Fit"; }
 
 MemoryBlock *WorstFitAllocator::find_free_block(size_t size) {
-  MemoryBlock *current = free_list_head;
-  MemoryBlock *worst_fit = nullptr;
-  size_t largest_size = 0;
-
-  while (current) {
-    if (current->size >= size && current->size > largest_size) {
-      largest_size = current->size;
-      worst_fit = current;
-    }
-    current = current->next;
+  if (free_blocks_by_size.empty()) {
+    return nullptr;
   }
 
-  return worst_fit;
+  size_t largest_size = (*free_blocks_by_size.rbegin())->size;
+  if (largest_size < size) {
+    return nullptr;
+  }
+
+  // Lowest address among the largest blocks.
+  MemoryBlock key(largest_size, 0);
+  return *free_blocks_by_size.lower_bound(&key);
 }
 
 AllocationResult WorstFitAllocator::allocate(size_t size) {
@@ -26,38 +23,12 @@ AllocationResult WorstFitAllocator::allocate(size_t size) {
     return AllocationResult(false, 0, 0, "Invalid alloc size");
   }
 
-  MemoryBlock *free_block = find_free_block(size);
+  MemoryBlock *free_block = find_free_block(block_size_for(size));
 
   if (!free_block) {
     stats.allocation_failures++;
     return AllocationResult(false, 0, 0, "No suitable bl");
   }
 
-  MemoryBlock *allocated_block;
-
-  if (free_block->size == size) {
-    allocated_block = free_block;
-    remove_from_free_list(free_block);
-    stats.num_free_blocks--;
-  } else {
-    allocated_block = new MemoryBlock(size, free_block->address);
-    free_block->size -= size;
-    free_block->address += size;
-  }
-
-  allocated_block->allocated = true;
-
-  size_t block_id = next_block_id++;
-  allocated_blocks.push_back(allocated_block);
-
-  stats.used_memory += size;
-  stats.free_memory -= size;
-  stats.num_allocations++;
-  stats.num_allocated_blocks++;
-
-  cout << "I[Allocator] Allocated block id=" << block_id << " at address=0x"
-       << hex << setw(4) << setfill('0') << allocated_block->address << dec
-       << " (size=" << size << ")" << endl;
-
-  return AllocationResult(true, block_id, allocated_block->address, "Success");
+  return allocate_from(free_block, size);
 }
@@ -9,26 +9,19 @@ using namespace std;
 
 BuddyAllocator::BuddyAllocator()
     : memory(nullptr), memory_size(0), min_block_size(32), max_block_size(0),
-      next_block_id(1), total_allocations(0), total_deallocations(0),
-      allocation_failures(0), internal_fragmentation_bytes(0) {}
+      free_orders_mask(0), total_allocations(0),
+      total_deallocations(0), allocation_failures(0),
+      internal_fragmentation_bytes(0), used_bytes(0), num_free_blocks(0) {
+  for (size_t order = 0; order < BUDDY_MAX_ORDERS; order++) {
+    free_lists[order] = nullptr;
+  }
+}
 
 BuddyAllocator::~BuddyAllocator() {
   if (memory) {
     delete[] memory;
   }
-
-  for (auto &pair : free_lists) {
-    BuddyBlock *current = pair.second;
-    while (current) {
-      BuddyBlock *next = current->next;
-      delete current;
-      current = next;
-    }
-  }
-
-  for (auto &pair : allocated_blocks) {
-    delete pair.second;
-  }
+  // Block nodes are released with block_pool.
 }
 
 bool BuddyAllocator::is_power_of_two(size_t n) {
@@ -36,22 +29,20 @@ bool BuddyAllocator::is_power_of_two(size_t n) {
 }
 
 size_t BuddyAllocator::round_up_to_power_of_two(size_t size) {
-  if (size == 0)
-    return 0;
+  if (size <= 1)
+    return size;
 
-  size_t power = 1;
-  while (power < size) {
-    power *= 2;
+  size_t bits = 64 - __builtin_clzll(size - 1);
+  if (bits >= 64) {
+    return 0; // overflow
   }
-  return power;
+  return static_cast<size_t>(1) << bits;
 }
 
 size_t BuddyAllocator::log2_size(size_t size) {
-  size_t log = 0;
-  while (size >>= 1) {
-    log++;
-  }
-  return log;
+  if (size == 0)
+    return 0;
+  return 63 - __builtin_clzll(size);
 }
 
 size_t BuddyAllocator::get_buddy_address(size_t address, size_t size) {
@@ -72,16 +63,30 @@ bool BuddyAllocator::init(size_t size, size_t min_size) {
   if (!is_power_of_two(min_size)) {
     min_size = round_up_to_power_of_two(min_size);
   }
+  if (min_size < sizeof(BuddyBlock *)) {
+    min_size = sizeof(BuddyBlock *);
+  }
+  if (size < min_size) {
+    size = min_size;
+    cout << "E[Buddy] Rounded to min block size: " << size << endl;
+  }
 
   memory_size = size;
   min_block_size = min_size;
   max_block_size = size;
+  allocated_blocks.set_max_slots(size / min_block_size);
 
   memory = new char[size];
   memset(memory, 0, size);
 
-  BuddyBlock *initial_block = new BuddyBlock(0, size);
-  free_lists[log2_size(size)] = initial_block;
+  size_t max_order = log2_size(size);
+  free_map.assign(max_order + 1, vector<bool>());
+  for (size_t order = log2_size(min_block_size); order <= max_order; order++) {
+    free_map[order].assign(size >> order, false);
+  }
+
+  BuddyBlock *initial_block = block_pool.create(0, size);
+  add_to_free_list(initial_block);
 
   cout << "I[Buddy] Initialized: " << size << " bytes" << endl;
   cout << "I[Buddy] Min block size: " << min_block_size << " bytes" << endl;
@@ -90,44 +95,61 @@ bool BuddyAllocator::init(size_t size, size_t min_size) {
 
 void BuddyAllocator::add_to_free_list(BuddyBlock *block) {
   size_t log_size = log2_size(block->size);
-  block->next = free_lists[log_size];
-  free_lists[log_size] = block;
+  BuddyBlock *&head = free_lists[log_size];
+
+  block->prev = nullptr;
+  block->next = head;
+  if (head) {
+    head->prev = block;
+  }
+  head = block;
+  num_free_blocks++;
+  free_orders_mask |= static_cast<size_t>(1) << log_size;
+
+  free_map[log_size][block->address >> log_size] = true;
+  memcpy(memory + block->address, &block, sizeof(BuddyBlock *));
 }
 
 void BuddyAllocator::remove_from_free_list(BuddyBlock *block) {
   size_t log_size = log2_size(block->size);
-  BuddyBlock **current = &free_lists[log_size];
 
-  while (*current) {
-    if (*current == block) {
-      *current = block->next;
-      block->next = nullptr;
-      return;
+  if (block->prev) {
+    block->prev->next = block->next;
+  } else {
+    free_lists[log_size] = block->next;
+    if (!block->next) {
+      free_orders_mask &= ~(static_cast<size_t>(1) << log_size);
     }
-    current = &((*current)->next);
   }
+  if (block->next) {
+    block->next->prev = block->prev;
+  }
+  block->prev = nullptr;
+  block->next = nullptr;
+  num_free_blocks--;
+
+  free_map[log_size][block->address >> log_size] = false;
 }
 
 BuddyBlock *BuddyAllocator::find_buddy(size_t address, size_t size) {
   size_t buddy_addr = get_buddy_address(address, size);
   size_t log_size = log2_size(size);
 
-  BuddyBlock *current = free_lists[log_size];
-  while (current) {
-    if (current->address == buddy_addr) {
-      return current;
-    }
-    current = current->next;
+  if (!free_map[log_size][buddy_addr >> log_size]) {
+    return nullptr;
   }
 
-  return nullptr;
+  BuddyBlock *buddy;
+  memcpy(&buddy, memory + buddy_addr, sizeof(BuddyBlock *));
+  return buddy;
 }
 
 void BuddyAllocator::split_block(BuddyBlock *block, size_t target_size) {
   while (block->size > target_size) {
     size_t new_size = block->size / 2;
     remove_from_free_list(block);
-    BuddyBlock *buddy = new BuddyBlock(block->address + new_size, new_size);
+    BuddyBlock *buddy =
+        block_pool.create(block->address + new_size, new_size);
     block->size = new_size;
     add_to_free_list(block);
     add_to_free_list(buddy);
@@ -147,10 +169,10 @@ BuddyBlock *BuddyAllocator::coalesce(BuddyBlock *block) {
     BuddyBlock *merged;
     if (block->address < buddy->address) {
       merged = block;
-      delete buddy;
+      block_pool.destroy(buddy);
     } else {
       merged = buddy;
-      delete block;
+      block_pool.destroy(block);
       block = merged;
     }
 
@@ -164,29 +186,30 @@ BuddyBlock *BuddyAllocator::coalesce(BuddyBlock *block) {
 BuddyBlock *BuddyAllocator::allocate_from_free_list(size_t size) {
   size_t log_size = log2_size(size);
 
-  if (free_lists[log_size]) {
-    BuddyBlock *block = free_lists[log_size];
-    remove_from_free_list(block);
-    return block;
+  // Smallest non-empty order that can hold the request.
+  size_t usable = free_orders_mask & (~static_cast<size_t>(0) << log_size);
+  if (!usable) {
+    return nullptr;
   }
 
-  for (size_t log = log_size + 1; log <= log2_size(max_block_size); log++) {
-    if (free_lists[log]) {
-      BuddyBlock *block = free_lists[log];
-      split_block(block, size);
-      block = free_lists[log_size];
-      remove_from_free_list(block);
-      return block;
-    }
+  size_t order = __builtin_ctzll(usable);
+  BuddyBlock *block = free_lists[order];
+  if (order > log_size) {
+    split_block(block, size);
+    block = free_lists[log_size];
   }
-
-  return nullptr;
+  remove_from_free_list(block);
+  return block;
 }
 
 BuddyAllocationResult BuddyAllocator::allocate(size_t size) {
   if (size == 0) {
     return BuddyAllocationResult(false, 0, 0, 0, "Invalid alloc size");
   }
+  if (size > max_block_size) {
+    allocation_failures++;
+    return BuddyAllocationResult(false, 0, 0, 0, "Out of memory");
+  }
   size_t actual_size = round_up_to_power_of_two(size);
   if (actual_size < min_block_size) {
     actual_size = min_block_size;
@@ -199,79 +222,72 @@ BuddyAllocationResult BuddyAllocator::allocate(size_t size) {
   }
 
   block->allocated = true;
-  size_t block_id = next_block_id++;
-  allocated_blocks[block_id] = block;
+  block->requested_size = size;
+  size_t block_id = allocated_blocks.insert(block);
   total_allocations++;
+  used_bytes += actual_size;
   internal_fragmentation_bytes += (actual_size - size);
 
-  cout << "I[Buddy] Allocated block id=" << block_id << " at address=0x" << hex
-       << setw(4) << setfill('0') << block->address << dec
-       << " (requested=" << size << ", actual=" << actual_size << ")" << endl;
-
   return BuddyAllocationResult(true, block_id, block->address, actual_size,
                                "Success");
 }
 
 bool BuddyAllocator::deallocate(size_t block_id) {
-  auto it = allocated_blocks.find(block_id);
+  BuddyBlock *block = allocated_blocks.lookup(block_id);
 
-  if (it == allocated_blocks.end()) {
+  if (!block) {
     cerr << "E[Buddy] Invalid block ID " << block_id << endl;
     return false;
   }
 
-  BuddyBlock *block = it->second;
-
   if (!block->allocated) {
     cerr << "E[Buddy] Block " << block_id << " is already free" << endl;
     return false;
   }
 
   block->allocated = false;
-  allocated_blocks.erase(it);
+  allocated_blocks.erase(block_id);
+  used_bytes -= block->size;
+  internal_fragmentation_bytes -= block->size - block->requested_size;
   add_to_free_list(block);
   coalesce(block);
 
   total_deallocations++;
 
-  cout << "I[Buddy] Block" << block_id << "freed" << endl;
-
   return true;
 }
 
 void BuddyAllocator::dump_memory() {
   cout << "\n~~~~~~~Buddy Memory Dump~~~~~~~~" << endl;
 
-  vector<BuddyBlock *> all_blocks;
-  for (auto &pair : free_lists) {
-    BuddyBlock *current = pair.second;
+  // (block, id) pairs; free blocks carry id 0.
+  vector<pair<BuddyBlock *, size_t>> all_blocks;
+  for (size_t order = 0; order < BUDDY_MAX_ORDERS; order++) {
+    BuddyBlock *current = free_lists[order];
     while (current) {
-      all_blocks.push_back(current);
+      all_blocks.push_back(make_pair(current, 0));
       current = current->next;
     }
   }
 
-  for (auto &pair : allocated_blocks) {
-    all_blocks.push_back(pair.second);
-  }
+  allocated_blocks.for_each([&all_blocks](size_t id, BuddyBlock *block) {
+    all_blocks.push_back(make_pair(block, id));
+  });
 
   sort(all_blocks.begin(), all_blocks.end(),
-       [](BuddyBlock *a, BuddyBlock *b) { return a->address < b->address; });
+       [](const pair<BuddyBlock *, size_t> &a,
+          const pair<BuddyBlock *, size_t> &b) {
+         return a.first->address < b.first->address;
+       });
 
-  for (auto block : all_blocks) {
+  for (auto &entry : all_blocks) {
+    BuddyBlock *block = entry.first;
     cout << "[0x" << hex << setw(4) << setfill('0') << block->address << " - 0x"
          << setw(4) << setfill('0') << (block->address + block->size - 1)
          << "] ";
 
     if (block->allocated) {
-      size_t block_id = 0;
-      for (auto &pair : allocated_blocks) {
-        if (pair.second == block) {
-          block_id = pair.first;
-          break;
-        }
-      }
-      cout << "I[Buddy] USED (id=" << dec << block_id
+      cout << "I[Buddy] USED (id=" << dec << entry.second
            << ", size=" << block->size << ")";
     } else {
       cout << "I[Buddy] FREE (size=" << dec << block->size << ")";
@@ -285,9 +301,9 @@ void BuddyAllocator::dump_memory() {
 void BuddyAllocator::dump_free_lists() {
   cout << "\n~~~~~~~Buddy Free Lists~~~~~~~" << endl;
 
-  for (auto &pair : free_lists) {
-    size_t block_size = (1ULL << pair.first);
-    BuddyBlock *current = pair.second;
+  for (size_t order = 0; order < BUDDY_MAX_ORDERS; order++) {
+    size_t block_size = (1ULL << order);
+    BuddyBlock *current = free_lists[order];
 
     if (current) {
       cout << "Size " << block_size << " bytes: ";
@@ -309,50 +325,33 @@ AllocationStats BuddyAllocator::get_stats() {
   AllocationStats stats;
 
   stats.total_memory = memory_size;
-
-  size_t used = 0;
-  for (auto &pair : allocated_blocks) {
-    used += pair.second->size;
-  }
-
-  stats.used_memory = used;
-  stats.free_memory = memory_size - used;
+  stats.used_memory = used_bytes;
+  stats.free_memory = memory_size - used_bytes;
   stats.num_allocations = total_allocations;
   stats.num_deallocations = total_deallocations;
   stats.allocation_failures = allocation_failures;
   stats.num_allocated_blocks = allocated_blocks.size();
+  stats.num_free_blocks = num_free_blocks;
+  stats.internal_fragmentation_bytes = internal_fragmentation_bytes;
+  stats.metadata_nodes = block_pool.get_slab_pool().in_use();
+  stats.metadata_pool_bytes = block_pool.get_slab_pool().footprint_bytes();
 
-  size_t free_block_count = 0;
-  for (auto &pair : free_lists) {
-    BuddyBlock *current = pair.second;
-    while (current) {
-      free_block_count++;
-      current = current->next;
-    }
-  }
-  stats.num_free_blocks = free_block_count;
-
-  if (used > 0) {
+  if (used_bytes > 0) {
     stats.internal_fragmentation =
-        (double)internal_fragmentation_bytes / used * 100.0;
+        (double)internal_fragmentation_bytes / used_bytes * 100.0;
   } else {
     stats.internal_fragmentation = 0.0;
   }
 
-  size_t largest_free = 0;
-  for (auto &pair : free_lists) {
-    BuddyBlock *current = pair.second;
-    while (current) {
-      if (current->size > largest_free) {
-        largest_free = current->size;
-      }
-      current = current->next;
-    }
+  // Every free block of the highest non-empty order has the largest size.
+  if (free_orders_mask) {
+    stats.largest_free_block = static_cast<size_t>(1)
+                               << log2_size(free_orders_mask);
   }
 
   if (stats.free_memory > 0) {
     stats.external_fragmentation =
-        (1.0 - (double)largest_free / stats.free_memory) * 100.0;
+        (1.0 - (double)stats.largest_free_block / stats.free_memory) * 100.0;
   } else {
     stats.external_fragmentation = 0.0;
   }
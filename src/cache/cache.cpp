@@ -1,10 +1,20 @@
 #include "../../include/cache.h"
+#include <algorithm>
 #include <stdexcept>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 CacheLevel::CacheLevel(const CacheConfig &cfg)
-    : config(cfg), stats(cfg.name), num_sets(0), global_time(0) {
+    : config(cfg), stats(cfg.name), num_sets(0), num_ways(0),
+      pow2_geometry(false), block_shift(0), set_shift(0), set_mask(0),
+      mask_words(0), global_time(0),
+      access_path(&CacheLevel::access_with<ANY_WAYS, ReplacementPolicy::FIFO>),
+      policy_words(0), random_state(0), brrip_fills(0), dirty_lines(0),
+      prefetched_lines(0), prefetch_hit(false) {
   if (config.size_bytes == 0 || config.block_size == 0 ||
       config.associativity == 0) {
     num_sets = 0;
@@ -23,120 +33,646 @@ CacheLevel::CacheLevel(const CacheConfig &cfg)
     throw runtime_error("E[Cache] Invalid cache configuration");
   }
 
-  sets.assign(num_sets, vector<CacheLine>(config.associativity));
+  if (is_power_of_two(config.block_size) && is_power_of_two(num_sets)) {
+    pow2_geometry = true;
+    block_shift = static_cast<unsigned>(__builtin_ctzll(config.block_size));
+    set_shift = static_cast<unsigned>(__builtin_ctzll(num_sets));
+    set_mask = num_sets - 1;
+  }
+
+  num_ways = config.associativity;
+  mask_words = (num_ways + 63) / 64;
+  tags.assign(num_sets * num_ways, 0);
+  valid_masks.assign(num_sets * mask_words, 0);
+  dirty_masks.assign(num_sets * mask_words, 0);
+  prefetch_masks.assign(num_sets * mask_words, 0);
+  init_policy_metadata();
+  if (config.classify_misses) {
+    shadow.init(config.block_size, 1, num_sets * num_ways);
+    first_touch.assign((static_cast<size_t>(1) << FIRST_TOUCH_LOG2) / 64, 0);
+  }
 }
 
 size_t CacheLevel::get_set_index(size_t address) const {
+  if (pow2_geometry) {
+    return (address >> block_shift) & set_mask;
+  }
   size_t block_addr = address / config.block_size;
   return block_addr % num_sets;
 }
 
 size_t CacheLevel::get_tag(size_t address) const {
+  if (pow2_geometry) {
+    return (address >> block_shift) >> set_shift;
+  }
   size_t block_addr = address / config.block_size;
   return block_addr / num_sets;
 }
 
+// Returns a bitmask with bit i set when tags[i] == tag, for count <= 64.
+static uint64_t match_tags(const uint64_t *tags, size_t count, uint64_t tag) {
+  uint64_t mask = 0;
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i key = _mm256_set1_epi64x(static_cast<long long>(tag));
+  for (; i + 4 <= count; i += 4) {
+    __m256i lanes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tags + i));
+    __m256i eq = _mm256_cmpeq_epi64(lanes, key);
+    uint64_t bits =
+        static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+    mask |= bits << i;
+  }
+#elif defined(__SSE2__)
+  // SSE2 has no 64-bit compare: a lane matches when both 32-bit halves do.
+  const __m128i key = _mm_set1_epi64x(static_cast<long long>(tag));
+  for (; i + 2 <= count; i += 2) {
+    __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tags + i));
+    __m128i eq32 = _mm_cmpeq_epi32(lanes, key);
+    __m128i eq = _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, 0xB1));
+    uint64_t bits =
+        static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(eq)));
+    mask |= bits << i;
+  }
+#endif
+  for (; i < count; ++i) {
+    if (tags[i] == tag) {
+      mask |= 1ULL << i;
+    }
+  }
+  return mask;
+}
+
 int CacheLevel::find_line_with_tag(size_t set_index, size_t tag) const {
-  const auto &set = sets[set_index];
-  for (size_t way = 0; way < set.size(); ++way) {
-    if (set[way].valid && set[way].tag == tag) {
-      return static_cast<int>(way);
+  const uint64_t *set_tags = &tags[set_index * num_ways];
+  const uint64_t *valid = &valid_masks[set_index * mask_words];
+
+  for (size_t word = 0; word < mask_words; ++word) {
+    size_t base = word * 64;
+    size_t count = min<size_t>(64, num_ways - base);
+    uint64_t hits = match_tags(set_tags + base, count, tag) & valid[word];
+    if (hits) {
+      return static_cast<int>(base + __builtin_ctzll(hits));
     }
   }
   return -1;
 }
 
 int CacheLevel::select_victim_line(size_t set_index) {
-  auto &set = sets[set_index];
+  const uint64_t *valid = &valid_masks[set_index * mask_words];
 
-  for (size_t way = 0; way < set.size(); ++way) {
-    if (!set[way].valid) {
-      return static_cast<int>(way);
+  for (size_t word = 0; word < mask_words; ++word) {
+    size_t base = word * 64;
+    size_t count = min<size_t>(64, num_ways - base);
+    uint64_t in_range = count == 64 ? ~0ULL : (1ULL << count) - 1;
+    uint64_t empty = ~valid[word] & in_range;
+    if (empty) {
+      return static_cast<int>(base + __builtin_ctzll(empty));
     }
   }
 
-  size_t victim = 0;
   switch (config.policy) {
-  case ReplacementPolicy::FIFO: {
-    size_t oldest_insert = set[0].insert_time;
-    for (size_t way = 1; way < set.size(); ++way) {
-      if (set[way].insert_time < oldest_insert) {
-        oldest_insert = set[way].insert_time;
-        victim = way;
-      }
-    }
+  case ReplacementPolicy::TREE_PLRU:
+    return static_cast<int>(tree_plru_victim(set_index));
+  case ReplacementPolicy::BIT_PLRU:
+    return static_cast<int>(bit_plru_victim(set_index));
+  case ReplacementPolicy::SRRIP:
+  case ReplacementPolicy::BRRIP:
+    return static_cast<int>(rrip_victim(set_index));
+  case ReplacementPolicy::RANDOM:
+    return static_cast<int>(random_victim());
+  default:
     break;
   }
-  case ReplacementPolicy::LRU: {
-    size_t oldest_access = set[0].last_access_time;
-    for (size_t way = 1; way < set.size(); ++way) {
-      if (set[way].last_access_time < oldest_access) {
-        oldest_access = set[way].last_access_time;
-        victim = way;
-      }
+
+  // FIFO, LRU and LFU evict the way with the smallest state value: the
+  // oldest insert, the oldest access or the fewest accesses.
+  const uint64_t *state = &policy_state[set_index * num_ways];
+  size_t victim = 0;
+  uint64_t lowest = state[0];
+  for (size_t way = 1; way < num_ways; ++way) {
+    if (state[way] < lowest) {
+      lowest = state[way];
+      victim = way;
     }
+  }
+
+  return static_cast<int>(victim);
+}
+
+inline void CacheLevel::on_hit(size_t set_index, size_t way,
+                        ReplacementPolicy policy) {
+  switch (policy) {
+  case ReplacementPolicy::FIFO:
+  case ReplacementPolicy::RANDOM:
+    break;
+  case ReplacementPolicy::LRU:
+    policy_state[set_index * num_ways + way] = global_time;
+    break;
+  case ReplacementPolicy::LFU:
+    ++policy_state[set_index * num_ways + way];
+    break;
+  case ReplacementPolicy::TREE_PLRU:
+    tree_plru_touch(set_index, way);
+    break;
+  case ReplacementPolicy::BIT_PLRU:
+    bit_plru_touch(set_index, way);
+    break;
+  case ReplacementPolicy::SRRIP:
+  case ReplacementPolicy::BRRIP:
+    rrip_set(set_index, way, 0);
     break;
   }
-  case ReplacementPolicy::LFU: {
-    size_t lowest_freq = set[0].frequency;
-    for (size_t way = 1; way < set.size(); ++way) {
-      if (set[way].frequency < lowest_freq) {
-        lowest_freq = set[way].frequency;
-        victim = way;
-      }
-    }
+}
+
+inline void CacheLevel::on_fill(size_t set_index, size_t way,
+                         ReplacementPolicy policy) {
+  switch (policy) {
+  case ReplacementPolicy::FIFO:
+  case ReplacementPolicy::LRU:
+    policy_state[set_index * num_ways + way] = global_time;
+    break;
+  case ReplacementPolicy::LFU:
+    policy_state[set_index * num_ways + way] = 1;
+    break;
+  case ReplacementPolicy::TREE_PLRU:
+    tree_plru_touch(set_index, way);
+    break;
+  case ReplacementPolicy::BIT_PLRU:
+    bit_plru_touch(set_index, way);
+    break;
+  case ReplacementPolicy::SRRIP:
+    rrip_set(set_index, way, RRPV_LONG);
+    break;
+  case ReplacementPolicy::BRRIP:
+    // Distant re-reference, except for one fill in BRRIP_THROTTLE.
+    rrip_set(set_index, way,
+             ++brrip_fills % BRRIP_THROTTLE == 0 ? RRPV_LONG : RRPV_DISTANT);
+    break;
+  case ReplacementPolicy::RANDOM:
     break;
   }
+}
+
+// Fixed-associativity lookup for Ways <= 64: the whole set fits in one
+// valid-mask word and the compare loop has a constant trip count.
+template <size_t Ways>
+int CacheLevel::find_way(size_t set_index, size_t tag) const {
+  uint64_t hits =
+      match_tags(&tags[set_index * Ways], Ways, tag) & valid_masks[set_index];
+  return hits ? __builtin_ctzll(hits) : -1;
+}
+
+template <size_t Ways>
+int CacheLevel::select_victim_way(size_t set_index) const {
+  const uint64_t all_ways = Ways == 64 ? ~0ULL : (1ULL << Ways) - 1;
+  uint64_t empty = ~valid_masks[set_index] & all_ways;
+  if (empty) {
+    return __builtin_ctzll(empty);
   }
 
+  const uint64_t *state = &policy_state[set_index * Ways];
+  size_t victim = 0;
+  for (size_t way = 1; way < Ways; ++way) {
+    if (state[way] < state[victim]) {
+      victim = way;
+    }
+  }
   return static_cast<int>(victim);
 }
 
-bool CacheLevel::access(size_t address) {
+inline bool CacheLevel::is_dirty(size_t set_index, size_t way) const {
+  return (dirty_masks[set_index * mask_words + way / 64] >> (way % 64)) & 1;
+}
+
+inline void CacheLevel::mark_dirty(size_t set_index, size_t way) {
+  uint64_t &word = dirty_masks[set_index * mask_words + way / 64];
+  uint64_t bit = 1ULL << (way % 64);
+  if (!(word & bit)) {
+    word |= bit;
+    ++dirty_lines;
+  }
+}
+
+// First demand hit on a prefetched line: the prefetch was useful.
+inline void CacheLevel::use_prefetched(size_t set_index, size_t way) {
+  uint64_t &word = prefetch_masks[set_index * mask_words + way / 64];
+  uint64_t bit = 1ULL << (way % 64);
+  if (word & bit) {
+    word &= ~bit;
+    --prefetched_lines;
+    ++stats.useful_prefetches;
+    prefetch_hit = true;
+  }
+}
+
+// A demand miss on a block a prefetch fill evicted.
+void CacheLevel::check_pollution(size_t address) {
+  if (polluted.erase(address / config.block_size)) {
+    ++stats.prefetch_pollution;
+  }
+}
+
+// Sets the block's two bits in the first-touch bitmap; true when either
+// was clear, i.e. the block was (almost certainly) never seen.
+bool CacheLevel::touch_first(size_t block) {
+  uint64_t h = block + 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+
+  size_t bits = static_cast<size_t>(1) << FIRST_TOUCH_LOG2;
+  bool first = false;
+  size_t positions[2] = {static_cast<size_t>(h) & (bits - 1),
+                         static_cast<size_t>(h >> 32) & (bits - 1)};
+  for (size_t i = 0; i < 2; ++i) {
+    uint64_t bit = 1ULL << (positions[i] % 64);
+    uint64_t &word = first_touch[positions[i] / 64];
+    first = first || !(word & bit);
+    word |= bit;
+  }
+  return first;
+}
+
+// Feeds the shadow LRU and classifies a miss: a first touch is compulsory,
+// a block the shadow no longer holds (it keeps only as many blocks as the
+// level has lines) is capacity, and anything a fully associative level
+// would have hit is conflict.
+void CacheLevel::classify(size_t address, bool hit) {
+  bool first = touch_first(address / config.block_size);
+  size_t distance = shadow.access(address);
+  if (!first && distance == StackDistanceProfiler::COLD) {
+    ++stats.distant_reuses;
+  }
+  if (hit) {
+    return;
+  }
+  if (first) {
+    ++stats.compulsory_misses;
+  } else if (distance == StackDistanceProfiler::COLD) {
+    ++stats.capacity_misses;
+  } else {
+    ++stats.conflict_misses;
+  }
+}
+
+// Installs tag in the given way. A dirty victim is reported in spill so the
+// hierarchy can write it back. Invalid lines are never dirty, and while no
+// line is dirty (read-only traces) the dirty masks are not touched at all.
+inline size_t CacheLevel::fill_line(size_t set_index, size_t way, size_t tag,
+                                    ReplacementPolicy policy,
+                                    CacheSpill &spill) {
+  size_t line = set_index * num_ways + way;
+  uint64_t &valid = valid_masks[set_index * mask_words + way / 64];
+  uint64_t bit = 1ULL << (way % 64);
+
+  if (valid & bit) {
+    spill.evicted = true;
+    spill.victim_address =
+        (tags[line] * num_sets + set_index) * config.block_size;
+    if (dirty_lines > 0 && is_dirty(set_index, way)) {
+      spill.victim_dirty = true;
+      ++stats.dirty_evictions;
+      stats.writeback_bytes += config.block_size;
+      dirty_masks[set_index * mask_words + way / 64] &= ~bit;
+      --dirty_lines;
+    }
+    if (prefetched_lines > 0 &&
+        (prefetch_masks[set_index * mask_words + way / 64] & bit)) {
+      prefetch_masks[set_index * mask_words + way / 64] &= ~bit;
+      --prefetched_lines;
+    }
+  }
+
+  valid |= bit;
+  tags[line] = tag;
+  on_fill(set_index, way, policy);
+  return way;
+}
+
+template <size_t Ways, ReplacementPolicy Policy>
+bool CacheLevel::access_with(size_t address, AccessType type,
+                             CacheSpill &spill) {
   if (num_sets == 0) {
     return false;
   }
 
+  const bool fixed = Ways != ANY_WAYS;
+  const ReplacementPolicy policy = fixed ? Policy : config.policy;
+  const bool is_write = type == AccessType::WRITE;
+
   ++stats.accesses;
   ++global_time;
+  if (is_write) {
+    ++stats.writes;
+  }
 
   size_t set_index = get_set_index(address);
   size_t tag = get_tag(address);
 
-  int line_index = find_line_with_tag(set_index, tag);
-  auto &set = sets[set_index];
+  int line_index = fixed ? find_way<Ways>(set_index, tag)
+                         : find_line_with_tag(set_index, tag);
+  size_t way;
+  if (shadow.enabled()) {
+    classify(address, line_index >= 0);
+  }
 
   if (line_index >= 0) {
-    CacheLine &line = set[static_cast<size_t>(line_index)];
     ++stats.hits;
-    line.last_access_time = global_time;
-    ++line.frequency;
-    return true;
+    way = static_cast<size_t>(line_index);
+    on_hit(set_index, way, policy);
+    if (prefetched_lines > 0) {
+      use_prefetched(set_index, way);
+    }
+  } else {
+    ++stats.misses;
+    if (!polluted.empty()) {
+      check_pollution(address);
+    }
+    if (is_write && !config.write_allocate) {
+      stats.writeback_bytes += CACHE_WORD_BYTES;
+      return false;
+    }
+    way = static_cast<size_t>(fixed ? select_victim_way<Ways>(set_index)
+                                    : select_victim_line(set_index));
+    fill_line(set_index, way, tag, policy, spill);
   }
 
-  ++stats.misses;
-  int victim_index = select_victim_line(set_index);
-  CacheLine &victim = set[static_cast<size_t>(victim_index)];
+  if (is_write) {
+    if (config.write_policy == WritePolicy::WRITE_BACK) {
+      mark_dirty(set_index, way);
+    } else {
+      spill.write_through = true;
+      stats.writeback_bytes += CACHE_WORD_BYTES;
+    }
+  }
 
-  victim.valid = true;
-  victim.tag = tag;
-  victim.insert_time = global_time;
-  victim.last_access_time = global_time;
-  victim.frequency = 1;
+  return line_index >= 0;
+}
 
+bool CacheLevel::absorb_write(size_t address, size_t bytes, CacheSpill &spill,
+                              bool allocate) {
+  if (num_sets == 0) {
+    return false;
+  }
+
+  size_t set_index = get_set_index(address);
+  size_t tag = get_tag(address);
+  int line_index = find_line_with_tag(set_index, tag);
+
+  if (line_index < 0) {
+    if (!allocate || !config.write_allocate) {
+      stats.writeback_bytes += bytes;
+      return false;
+    }
+    ++global_time;
+    line_index = select_victim_line(set_index);
+    fill_line(set_index, static_cast<size_t>(line_index), tag, config.policy,
+              spill);
+  }
+
+  if (config.write_policy == WritePolicy::WRITE_BACK) {
+    mark_dirty(set_index, static_cast<size_t>(line_index));
+    return true;
+  }
+  stats.writeback_bytes += bytes;
   return false;
 }
 
+template <ReplacementPolicy Policy>
+CacheLevel::AccessPath CacheLevel::fixed_path(size_t ways) {
+  switch (ways) {
+  case 1:
+    return &CacheLevel::access_with<1, Policy>;
+  case 2:
+    return &CacheLevel::access_with<2, Policy>;
+  case 4:
+    return &CacheLevel::access_with<4, Policy>;
+  case 8:
+    return &CacheLevel::access_with<8, Policy>;
+  case 16:
+    return &CacheLevel::access_with<16, Policy>;
+  default:
+    return nullptr;
+  }
+}
+
+bool CacheLevel::specialize() {
+  if (num_sets == 0) {
+    return false;
+  }
+
+  AccessPath path = nullptr;
+  switch (config.policy) {
+  case ReplacementPolicy::FIFO:
+    path = fixed_path<ReplacementPolicy::FIFO>(num_ways);
+    break;
+  case ReplacementPolicy::LRU:
+    path = fixed_path<ReplacementPolicy::LRU>(num_ways);
+    break;
+  case ReplacementPolicy::LFU:
+    path = fixed_path<ReplacementPolicy::LFU>(num_ways);
+    break;
+  default:
+    break;
+  }
+
+  if (!path) {
+    return false;
+  }
+  access_path = path;
+  return true;
+}
+
+bool CacheLevel::is_specialized() const {
+  return access_path != &CacheLevel::access_with<ANY_WAYS, ReplacementPolicy::FIFO>;
+}
+
+// Clears a valid line; the caller has already dealt with its data.
+void CacheLevel::drop_line(size_t set_index, size_t way) {
+  uint64_t bit = 1ULL << (way % 64);
+  valid_masks[set_index * mask_words + way / 64] &= ~bit;
+  uint64_t &dirty = dirty_masks[set_index * mask_words + way / 64];
+  if (dirty & bit) {
+    dirty &= ~bit;
+    --dirty_lines;
+  }
+  uint64_t &prefetched = prefetch_masks[set_index * mask_words + way / 64];
+  if (prefetched & bit) {
+    prefetched &= ~bit;
+    --prefetched_lines;
+  }
+}
+
+bool CacheLevel::take(size_t address, bool &dirty) {
+  if (num_sets == 0) {
+    return false;
+  }
+
+  ++stats.accesses;
+  size_t set_index = get_set_index(address);
+  int line_index = find_line_with_tag(set_index, get_tag(address));
+  if (shadow.enabled()) {
+    classify(address, line_index >= 0);
+  }
+  if (line_index < 0) {
+    ++stats.misses;
+    return false;
+  }
+
+  ++stats.hits;
+  dirty = is_dirty(set_index, static_cast<size_t>(line_index));
+  drop_line(set_index, static_cast<size_t>(line_index));
+  return true;
+}
+
+void CacheLevel::insert_victim(size_t address, bool dirty, CacheSpill &spill) {
+  if (num_sets == 0) {
+    return;
+  }
+
+  ++stats.victims_received;
+  ++global_time;
+  size_t set_index = get_set_index(address);
+  size_t tag = get_tag(address);
+  int line_index = find_line_with_tag(set_index, tag);
+  if (line_index < 0) {
+    line_index = select_victim_line(set_index);
+    fill_line(set_index, static_cast<size_t>(line_index), tag, config.policy,
+              spill);
+  }
+  if (dirty) {
+    mark_dirty(set_index, static_cast<size_t>(line_index));
+  }
+}
+
+bool CacheLevel::invalidate(size_t address, bool &dirty) {
+  if (num_sets == 0) {
+    return false;
+  }
+
+  size_t set_index = get_set_index(address);
+  int line_index = find_line_with_tag(set_index, get_tag(address));
+  if (line_index < 0) {
+    return false;
+  }
+
+  ++stats.back_invalidations;
+  dirty = is_dirty(set_index, static_cast<size_t>(line_index));
+  if (dirty) {
+    ++stats.dirty_evictions;
+    stats.writeback_bytes += config.block_size;
+  }
+  drop_line(set_index, static_cast<size_t>(line_index));
+  return true;
+}
+
+bool CacheLevel::probe(size_t address, bool &dirty) const {
+  if (num_sets == 0) {
+    return false;
+  }
+
+  size_t set_index = get_set_index(address);
+  int line_index = find_line_with_tag(set_index, get_tag(address));
+  if (line_index < 0) {
+    return false;
+  }
+  dirty = is_dirty(set_index, static_cast<size_t>(line_index));
+  return true;
+}
+
+bool CacheLevel::snoop(size_t address, bool invalidate, bool &dirty) {
+  if (num_sets == 0) {
+    return false;
+  }
+
+  size_t set_index = get_set_index(address);
+  int line_index = find_line_with_tag(set_index, get_tag(address));
+  if (line_index < 0) {
+    return false;
+  }
+
+  size_t way = static_cast<size_t>(line_index);
+  dirty = is_dirty(set_index, way);
+  if (invalidate) {
+    drop_line(set_index, way);
+  } else if (dirty) {
+    dirty_masks[set_index * mask_words + way / 64] &= ~(1ULL << (way % 64));
+    --dirty_lines;
+  }
+  return true;
+}
+
+int CacheLevel::fill_absent(size_t address, CacheSpill &spill) {
+  if (num_sets == 0) {
+    return -1;
+  }
+
+  size_t set_index = get_set_index(address);
+  size_t tag = get_tag(address);
+  if (find_line_with_tag(set_index, tag) >= 0) {
+    return -1;
+  }
+
+  ++global_time;
+  int way = select_victim_line(set_index);
+  fill_line(set_index, static_cast<size_t>(way), tag, config.policy, spill);
+  return way;
+}
+
+bool CacheLevel::install(size_t address, CacheSpill &spill) {
+  return fill_absent(address, spill) >= 0;
+}
+
+bool CacheLevel::prefetch_fill(size_t address, CacheSpill &spill) {
+  int filled = fill_absent(address, spill);
+  if (filled < 0) {
+    return false;
+  }
+
+  size_t set_index = get_set_index(address);
+  size_t way = static_cast<size_t>(filled);
+  prefetch_masks[set_index * mask_words + way / 64] |= 1ULL << (way % 64);
+  ++prefetched_lines;
+  ++stats.prefetch_fills;
+
+  // A victim missed again soon was displaced by the prefetch. Past a few
+  // cache capacities of victims, demand misses would have evicted it too,
+  // so older entries are forgotten.
+  polluted.erase(address / config.block_size);
+  if (spill.evicted) {
+    if (polluted.size() >= 4 * num_sets * num_ways) {
+      polluted.clear();
+    }
+    polluted.insert(spill.victim_address / config.block_size);
+  }
+  return true;
+}
+
 void CacheLevel::reset() {
-  stats.accesses = stats.hits = stats.misses = 0;
+  stats = CacheStats(config.name);
   global_time = 0;
-  for (auto &set : sets) {
-    for (auto &line : set) {
-      line.valid = false;
-      line.tag = 0;
-      line.last_access_time = 0;
-      line.insert_time = 0;
-      line.frequency = 0;
-    }
+  fill(tags.begin(), tags.end(), 0);
+  fill(valid_masks.begin(), valid_masks.end(), 0);
+  fill(dirty_masks.begin(), dirty_masks.end(), 0);
+  dirty_lines = 0;
+  fill(prefetch_masks.begin(), prefetch_masks.end(), 0);
+  prefetched_lines = 0;
+  polluted.clear();
+  prefetch_hit = false;
+  init_policy_metadata();
+  if (shadow.enabled()) {
+    shadow.init(config.block_size, 1, num_sets * num_ways);
+    fill(first_touch.begin(), first_touch.end(), 0);
+  }
+}
+
+CacheStats CacheLevel::get_stats() const {
+  CacheStats out = stats;
+  if (shadow.enabled()) {
+    out.classified = true;
+    out.reuse_histogram = shadow.get_histogram();
+    out.reuse_histogram.resize(num_sets * num_ways, 0);
   }
+  return out;
 }
@@ -1,27 +1,361 @@
 #include "../../include/cache.h"
+#include "../../include/prefetch.h"
+#include <algorithm>
 
-CacheHierarchy::CacheHierarchy() = default;
+CacheHierarchy::CacheHierarchy() : inclusion(InclusionPolicy::NINE) {}
 
-void CacheHierarchy::set_levels(const vector<CacheConfig> &level_configs) {
+CacheHierarchy::~CacheHierarchy() { clear_prefetchers(); }
+
+bool parse_inclusion_policy(const string &name, InclusionPolicy &policy) {
+  if (name == "nine") {
+    policy = InclusionPolicy::NINE;
+  } else if (name == "inclusive") {
+    policy = InclusionPolicy::INCLUSIVE;
+  } else if (name == "exclusive") {
+    policy = InclusionPolicy::EXCLUSIVE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *inclusion_policy_name(InclusionPolicy policy) {
+  switch (policy) {
+  case InclusionPolicy::NINE:
+    return "nine";
+  case InclusionPolicy::INCLUSIVE:
+    return "inclusive";
+  case InclusionPolicy::EXCLUSIVE:
+    return "exclusive";
+  }
+  return "unknown";
+}
+
+void CacheHierarchy::set_levels(const vector<CacheConfig> &level_configs,
+                                InclusionPolicy policy) {
+  inclusion = policy;
+  clear_prefetchers();
+  sampler.clear();
   levels.clear();
   levels.reserve(level_configs.size());
-  for (const auto &cfg : level_configs) {
+  for (CacheConfig cfg : level_configs) {
+    if (inclusion == InclusionPolicy::EXCLUSIVE) {
+      cfg.write_allocate = true;
+    }
     levels.emplace_back(CacheLevel(cfg));
+    levels.back().specialize();
+  }
+  latency.set_levels(level_configs);
+
+  // Prefetch fills would put a second copy of a block in an exclusive
+  // hierarchy, so it gets none.
+  if (inclusion == InclusionPolicy::EXCLUSIVE) {
+    return;
+  }
+  for (const auto &level : levels) {
+    const CacheConfig &cfg = level.get_config();
+    if (cfg.prefetch.kind != PrefetchKind::NONE) {
+      prefetchers.assign(levels.size(), nullptr);
+      in_flight.assign(levels.size(), vector<size_t>());
+      break;
+    }
+  }
+  for (size_t i = 0; i < prefetchers.size(); ++i) {
+    const CacheConfig &cfg = levels[i].get_config();
+    prefetchers[i] = make_prefetcher(cfg.prefetch, cfg.block_size);
+  }
+}
+
+void CacheHierarchy::clear_prefetchers() {
+  for (Prefetcher *prefetcher : prefetchers) {
+    delete prefetcher;
+  }
+  prefetchers.clear();
+  in_flight.clear();
+}
+
+bool CacheHierarchy::set_sampling(double fraction) {
+  vector<size_t> sets;
+  for (const auto &level : levels) {
+    if (level.get_config().block_size != levels[0].get_config().block_size) {
+      return false;
+    }
+    sets.push_back(level.get_num_sets());
   }
+  return !levels.empty() &&
+         sampler.init(sets, levels[0].get_config().block_size, fraction);
 }
 
-int CacheHierarchy::access(size_t address) {
+void LatencyModel::set_levels(const vector<CacheConfig> &configs) {
+  hit_cycles.assign(configs.size(), 0);
+  uint64_t above = 0;
+  for (size_t i = 0; i < configs.size(); ++i) {
+    hit_cycles[i] = above + configs[i].hit_latency;
+    above = hit_cycles[i] + configs[i].miss_penalty;
+  }
+  memory_cycles = above + (configs.empty() ? 0 : configs.back().memory_latency);
+  stats = LatencyStats();
+}
+
+void LatencyModel::record(int hit_level, uint64_t translation_cycles) {
+  uint64_t cycles = cost(hit_level);
+  ++stats.accesses;
+  stats.cache_cycles += cycles;
+  stats.translation_cycles += translation_cycles;
+  uint64_t total = cycles + translation_cycles;
+  ++stats.histogram[total > 1 ? 63 - __builtin_clzll(total) : 0];
+}
+
+int CacheHierarchy::access(size_t address, AccessType type,
+                           uint64_t translation_cycles) {
   if (levels.empty()) {
     return -1;
   }
+  // Unsampled blocks never reach a level: sampled sets see all their traffic
+  // and no other.
+  int slot = 0;
+  if (sampler.enabled()) {
+    slot = sampler.slot(address);
+    if (slot == SetSampler::SKIPPED) {
+      sampler.skip();
+      return NOT_SAMPLED;
+    }
+  }
+  int hit_level = inclusion == InclusionPolicy::EXCLUSIVE
+                      ? access_exclusive(address, type)
+                      : access_levels(address, type);
+  latency.record(hit_level, translation_cycles);
+  if (sampler.enabled()) {
+    sampler.record(slot, hit_level);
+  }
+  return hit_level;
+}
 
+// Demand path: each level that misses passes the request down, as a read
+// (the line fill) unless it did not allocate a missed write. Writebacks and
+// write-through words are pushed down after the demand walk, so they do not
+// turn the walk's own misses into hits.
+int CacheHierarchy::access_levels(size_t address, AccessType type) {
+  pending_writes.clear();
+
+  int hit_level = -1;
   for (size_t i = 0; i < levels.size(); ++i) {
-    if (levels[i].access(address)) {
-      return static_cast<int>(i);
+    CacheSpill spill;
+    bool hit = levels[i].access(address, type, spill);
+    if (!prefetchers.empty() && prefetchers[i] &&
+        run_prefetcher(i, address, hit)) {
+      hit = true;
+      // A no-write-allocate level did not keep the store; it goes on down.
+      if (type == AccessType::WRITE && !levels[i].get_config().write_allocate) {
+        pending_writes.push_back(PendingWrite(i + 1, address, CACHE_WORD_BYTES));
+      }
+    }
+
+    if (spill.evicted && i > 0 && inclusion == InclusionPolicy::INCLUSIVE) {
+      back_invalidate(i, spill.victim_address);
+    }
+    if (spill.victim_dirty) {
+      pending_writes.push_back(PendingWrite(
+          i + 1, spill.victim_address, levels[i].get_config().block_size));
+    }
+    if (spill.write_through) {
+      pending_writes.push_back(PendingWrite(i + 1, address, CACHE_WORD_BYTES));
+    }
+
+    if (hit) {
+      hit_level = static_cast<int>(i);
+      break;
+    }
+    if (type == AccessType::WRITE && levels[i].get_config().write_allocate) {
+      type = AccessType::READ;
+    }
+  }
+
+  for (size_t i = 0; i < pending_writes.size(); ++i) {
+    PendingWrite write = pending_writes[i];
+    write_down(write.level, write.address, write.bytes);
+  }
+  return hit_level;
+}
+
+// Exclusive path: the block always ends up in L1 (write-allocate is implied
+// there). A hit further down moves the line up, keeping its dirty state,
+// and L1's victim moves down one level, pushing that level's victim further.
+int CacheHierarchy::access_exclusive(size_t address, AccessType type) {
+  pending_writes.clear();
+
+  CacheSpill spill;
+  int hit_level = levels[0].access(address, type, spill) ? 0 : -1;
+
+  if (hit_level < 0) {
+    for (size_t i = 1; i < levels.size(); ++i) {
+      bool dirty = false;
+      if (levels[i].take(address, dirty)) {
+        hit_level = static_cast<int>(i);
+        if (dirty) {
+          CacheSpill unused;
+          if (!levels[0].absorb_write(address, levels[i].get_config().block_size,
+                                      unused, false)) {
+            pending_writes.push_back(
+                PendingWrite(1, address, levels[i].get_config().block_size));
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  if (spill.evicted) {
+    move_victim_down(1, spill);
+  }
+  if (spill.write_through) {
+    pending_writes.push_back(PendingWrite(1, address, CACHE_WORD_BYTES));
+  }
+
+  for (size_t i = 0; i < pending_writes.size(); ++i) {
+    PendingWrite write = pending_writes[i];
+    write_down(write.level, write.address, write.bytes);
+  }
+  return hit_level;
+}
+
+// Runs after a demand access to level. A miss on a block still in flight
+// is a late prefetch; then the previous access's requests arrive, and the
+// prefetcher sees this access. Returns true when a stream buffer served
+// the miss, which ends the demand walk there.
+bool CacheHierarchy::run_prefetcher(size_t level, size_t address, bool hit) {
+  Prefetcher *prefetcher = prefetchers[level];
+  CacheLevel &cache = levels[level];
+  size_t block_size = cache.get_config().block_size;
+  size_t block = address / block_size;
+  vector<size_t> &flight = in_flight[level];
+
+  bool first_use = hit && cache.take_prefetch_hit();
+  bool served = false;
+  if (!hit) {
+    auto pending = find(flight.begin(), flight.end(), block);
+    bool late = pending != flight.end();
+    if (late) {
+      flight.erase(pending);
+      cache.note_late_prefetch();
+    }
+    // A buffered block still in flight is consumed but cannot serve the
+    // miss, which goes on down like any other late prefetch.
+    if (prefetcher->buffers_lines() && prefetcher->take(block) && !late) {
+      cache.note_buffer_hit();
+      served = true;
+    }
+  }
+
+  for (size_t arrived : flight) {
+    if (prefetcher->buffers_lines()) {
+      cache.note_buffer_fill();
+      continue;
+    }
+    if (inclusion == InclusionPolicy::INCLUSIVE) {
+      install_below(level, arrived * block_size);
+    }
+    CacheSpill spill;
+    if (!cache.prefetch_fill(arrived * block_size, spill)) {
+      continue;
+    }
+    if (spill.evicted && level > 0 &&
+        inclusion == InclusionPolicy::INCLUSIVE) {
+      back_invalidate(level, spill.victim_address);
+    }
+    if (spill.victim_dirty) {
+      pending_writes.push_back(
+          PendingWrite(level + 1, spill.victim_address, block_size));
+    }
+  }
+  flight.clear();
+
+  requests.clear();
+  prefetcher->observe(block, hit, first_use, requests);
+  for (size_t request : requests) {
+    if (find(flight.begin(), flight.end(), request) == flight.end()) {
+      flight.push_back(request);
+    }
+  }
+  return served;
+}
+
+// Inclusion for a prefetch fill into level: every level below it gets the
+// block first, from the last level up, evicting as a demand fill would.
+void CacheHierarchy::install_below(size_t level, size_t address) {
+  for (size_t lower = levels.size() - 1; lower > level; --lower) {
+    CacheSpill spill;
+    if (!levels[lower].install(address, spill)) {
+      continue;
+    }
+    if (spill.evicted) {
+      back_invalidate(lower, spill.victim_address);
+    }
+    if (spill.victim_dirty) {
+      pending_writes.push_back(PendingWrite(
+          lower + 1, spill.victim_address, levels[lower].get_config().block_size));
+    }
+  }
+}
+
+// Places a victim from level - 1 into level. The last level's victims
+// leave the hierarchy; a dirty one was already counted as memory traffic
+// when it was evicted.
+void CacheHierarchy::move_victim_down(size_t level, const CacheSpill &spill) {
+  CacheSpill victim = spill;
+  for (; level < levels.size() && victim.evicted; ++level) {
+    CacheSpill next;
+    levels[level].insert_victim(victim.victim_address, victim.victim_dirty,
+                                next);
+    victim = next;
+  }
+}
+
+// Drops every line above level that lies inside the block level just
+// evicted. Dirty data is kept by the first write-back level on the way down
+// that still holds the block (and is written on when that level's copy is
+// dropped in turn); otherwise it passes through the evicting level, which
+// counts it, and goes to the level below.
+void CacheHierarchy::back_invalidate(size_t level, size_t address) {
+  size_t block = levels[level].get_config().block_size;
+  for (size_t upper = 0; upper < level; ++upper) {
+    size_t line = levels[upper].get_config().block_size;
+    for (size_t a = address - address % line; a < address + block; a += line) {
+      bool dirty = false;
+      if (!levels[upper].invalidate(a, dirty) || !dirty) {
+        continue;
+      }
+      CacheSpill unused;
+      size_t pass = upper + 1;
+      while (pass < level && !levels[pass].absorb_write(a, line, unused, false)) {
+        ++pass;
+      }
+      if (pass == level) {
+        levels[level].absorb_write(a, line, unused, false);
+        pending_writes.push_back(PendingWrite(level + 1, a, line));
+      }
     }
   }
+}
 
-  return -1;
+// Pushes written data down from level until a level keeps it. Exclusive
+// hierarchies never allocate here, since the line may live further up.
+void CacheHierarchy::write_down(size_t level, size_t address, size_t bytes) {
+  bool allocate = inclusion != InclusionPolicy::EXCLUSIVE;
+  for (; level < levels.size(); ++level) {
+    CacheSpill spill;
+    bool kept = levels[level].absorb_write(address, bytes, spill, allocate);
+    if (spill.evicted && inclusion == InclusionPolicy::INCLUSIVE) {
+      back_invalidate(level, spill.victim_address);
+    }
+    if (spill.victim_dirty) {
+      write_down(level + 1, spill.victim_address,
+                 levels[level].get_config().block_size);
+    }
+    if (kept) {
+      return;
+    }
+  }
 }
 
 vector<CacheStats> CacheHierarchy::get_stats() const {
@@ -37,4 +371,12 @@ void CacheHierarchy::reset() {
   for (auto &level : levels) {
     level.reset();
   }
+  latency.reset();
+  sampler.reset();
+  for (size_t i = 0; i < prefetchers.size(); ++i) {
+    if (prefetchers[i]) {
+      prefetchers[i]->reset();
+    }
+    in_flight[i].clear();
+  }
 }
@@ -0,0 +1,180 @@
+#include "../../include/cache_sweep.h"
+#include <algorithm>
+#include <stdexcept>
+
+CacheSweep::CacheSweep()
+    : filling(0), current(nullptr), generation(0), busy(0), stopping(false) {}
+
+CacheSweep::~CacheSweep() { stop(); }
+
+bool CacheSweep::start(const vector<CacheConfig> &level_configs,
+                       size_t threads, size_t &skipped) {
+  stop();
+  skipped = 0;
+
+  // With one thread the reader runs the single worker itself.
+  size_t count = max<size_t>(1, min(threads, level_configs.size()));
+  vector<Worker *> built;
+  for (size_t w = 0; w < count; ++w) {
+    built.push_back(new Worker());
+  }
+  for (const CacheConfig &cfg : level_configs) {
+    Worker *worker = built[configs.size() % count];
+    try {
+      worker->levels.push_back(CacheLevel(cfg));
+    } catch (const runtime_error &) {
+      ++skipped;
+      continue;
+    }
+    worker->levels.back().specialize();
+    worker->latency.push_back(LatencyModel());
+    worker->latency.back().set_levels(vector<CacheConfig>(1, cfg));
+    worker->index.push_back(configs.size());
+    configs.push_back(cfg);
+  }
+
+  for (Worker *worker : built) {
+    if (worker->levels.empty()) {
+      delete worker;
+    } else {
+      workers.push_back(worker);
+    }
+  }
+  if (configs.empty()) {
+    return false;
+  }
+
+  batches[0].reserve(BATCH);
+  batches[1].reserve(BATCH);
+  stopping = false;
+  if (workers.size() > 1) {
+    for (Worker *worker : workers) {
+      worker->runner = thread(&CacheSweep::run, this, worker);
+    }
+  }
+  return true;
+}
+
+void CacheSweep::stop() {
+  if (workers.empty()) {
+    return;
+  }
+  wait_idle();
+  if (workers.size() > 1) {
+    {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+    }
+    work_ready.notify_all();
+    for (Worker *worker : workers) {
+      worker->runner.join();
+    }
+  }
+  for (Worker *worker : workers) {
+    delete worker;
+  }
+  workers.clear();
+  configs.clear();
+  batches[0].clear();
+  batches[1].clear();
+  current = nullptr;
+  generation = 0;
+}
+
+// Waits for the previous batch, then starts the workers on the one just
+// filled and switches the reader to the other.
+void CacheSweep::publish() {
+  vector<SweepAccess> &full = batches[filling];
+  if (full.empty()) {
+    return;
+  }
+  if (workers.size() == 1) {
+    simulate(*workers[0], full);
+    full.clear();
+    return;
+  }
+
+  {
+    unique_lock<mutex> guard(lock);
+    work_done.wait(guard, [this] { return busy == 0; });
+    current = &full;
+    busy = workers.size();
+    ++generation;
+  }
+  work_ready.notify_all();
+  filling ^= 1;
+  batches[filling].clear();
+}
+
+void CacheSweep::wait_idle() {
+  publish();
+  unique_lock<mutex> guard(lock);
+  work_done.wait(guard, [this] { return busy == 0; });
+}
+
+void CacheSweep::run(Worker *worker) {
+  uint64_t seen = 0;
+  while (true) {
+    const vector<SweepAccess> *batch;
+    {
+      unique_lock<mutex> guard(lock);
+      work_ready.wait(guard,
+                      [this, seen] { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+      batch = current;
+    }
+
+    simulate(*worker, *batch);
+
+    bool last;
+    {
+      lock_guard<mutex> guard(lock);
+      last = --busy == 0;
+    }
+    if (last) {
+      work_done.notify_all();
+    }
+  }
+}
+
+// Every level of the worker over one chunk, then the next chunk.
+void CacheSweep::simulate(Worker &worker, const vector<SweepAccess> &batch) {
+  for (size_t start = 0; start < batch.size(); start += CHUNK) {
+    size_t end = min(batch.size(), start + CHUNK);
+    for (size_t l = 0; l < worker.levels.size(); ++l) {
+      CacheLevel &level = worker.levels[l];
+      LatencyModel &latency = worker.latency[l];
+      for (size_t i = start; i < end; ++i) {
+        const SweepAccess &a = batch[i];
+        CacheSpill spill;
+        bool hit = level.access(a.address, a.type, spill);
+        latency.record(hit ? 0 : -1, a.translation_cycles);
+      }
+    }
+  }
+}
+
+vector<CacheStats> CacheSweep::get_stats() {
+  wait_idle();
+  vector<CacheStats> out(configs.size());
+  for (Worker *worker : workers) {
+    for (size_t l = 0; l < worker->levels.size(); ++l) {
+      out[worker->index[l]] = worker->levels[l].get_stats();
+    }
+  }
+  return out;
+}
+
+vector<LatencyStats> CacheSweep::get_latency() {
+  wait_idle();
+  vector<LatencyStats> out(configs.size());
+  for (Worker *worker : workers) {
+    for (size_t l = 0; l < worker->latency.size(); ++l) {
+      out[worker->index[l]] = worker->latency[l].get_stats();
+    }
+  }
+  return out;
+}
@@ -0,0 +1,354 @@
+#include "../../include/coherence.h"
+#include <algorithm>
+
+CoherentHierarchy::CoherentHierarchy() : private_levels(0), block_size(0) {}
+
+void CoherentHierarchy::set_levels(size_t num_cores,
+                                   const vector<CacheConfig> &private_configs,
+                                   const vector<CacheConfig> &shared_configs) {
+  cores.clear();
+  shared.clear();
+  chains.clear();
+  hotspots.clear();
+  hotspot_order.clear();
+  private_levels = private_configs.size();
+  block_size = private_configs.empty() ? shared_configs[0].block_size
+                                       : private_configs[0].block_size;
+
+  size_t private_lines = 0;
+  for (const auto &cfg : private_configs) {
+    private_lines += cfg.size_bytes / cfg.block_size;
+  }
+  cores.resize(num_cores);
+  for (auto &core : cores) {
+    core.levels.reserve(private_configs.size());
+    for (const auto &cfg : private_configs) {
+      core.levels.emplace_back(CacheLevel(cfg));
+      core.levels.back().specialize();
+    }
+    core.lost_order.assign(max<size_t>(1, private_lines), 0);
+  }
+  shared.reserve(shared_configs.size());
+  for (const auto &cfg : shared_configs) {
+    shared.emplace_back(CacheLevel(cfg));
+    shared.back().specialize();
+  }
+
+  vector<CacheConfig> chain_configs(private_configs);
+  chain_configs.insert(chain_configs.end(), shared_configs.begin(),
+                       shared_configs.end());
+  for (auto &core : cores) {
+    core.latency.set_levels(chain_configs);
+  }
+
+  chains.resize(num_cores);
+  for (size_t c = 0; c < num_cores; ++c) {
+    for (auto &level : cores[c].levels) {
+      chains[c].push_back(&level);
+    }
+    for (auto &level : shared) {
+      chains[c].push_back(&level);
+    }
+  }
+}
+
+// The demand walk is the NINE walk of CacheHierarchy over the core's chain,
+// with the coherence actions placed where the bus would see them: a write
+// invalidates the other copies before it is performed, and a read that
+// misses every private level snoops before going to the shared levels.
+int CoherentHierarchy::access(size_t core, size_t address, AccessType type,
+                              uint64_t translation_cycles) {
+  if (cores.empty()) {
+    return -1;
+  }
+
+  Core &me = cores[core];
+  const vector<CacheLevel *> &chain = chains[core];
+  size_t block = address - address % block_size;
+  bool write = type == AccessType::WRITE;
+  bool remote = false;
+  pending_writes.clear();
+  departed.clear();
+
+  if (write && !holds_modified(me, address)) {
+    bool held = holds(me, address);
+    uint64_t sent = me.coherence.invalidations_sent;
+    remote = invalidate_others(core, address);
+    if (held && me.coherence.invalidations_sent != sent) {
+      ++me.coherence.upgrades;
+    }
+  }
+
+  int hit_level = -1;
+  for (size_t i = 0; i < chain.size(); ++i) {
+    if (i == private_levels) {
+      if (me.lost.erase(block)) {
+        ++me.coherence.coherence_misses;
+      }
+      me.touched[block] = 0;
+      if (!write) {
+        remote = downgrade_others(core, address);
+      }
+      if (remote) {
+        ++me.coherence.cache_to_cache;
+        // A write no private level allocated still has to land somewhere.
+        if (type == AccessType::WRITE) {
+          pending_writes.push_back(
+              PendingWrite(private_levels, address, CACHE_WORD_BYTES));
+        }
+        hit_level = REMOTE_HIT;
+        break;
+      }
+    }
+
+    CacheSpill spill;
+    bool hit = chain[i]->access(address, type, spill);
+    if (spill.evicted && i < private_levels) {
+      departed.push_back(spill.victim_address);
+    }
+    if (spill.victim_dirty) {
+      pending_writes.push_back(
+          PendingWrite(i + 1, spill.victim_address, block_size));
+    }
+    if (spill.write_through) {
+      pending_writes.push_back(PendingWrite(i + 1, address, CACHE_WORD_BYTES));
+    }
+
+    if (hit) {
+      hit_level = static_cast<int>(i);
+      break;
+    }
+    if (type == AccessType::WRITE && chain[i]->get_config().write_allocate) {
+      type = AccessType::READ;
+    }
+  }
+  me.touched[block] |= word_bit(address);
+
+  for (size_t i = 0; i < pending_writes.size(); ++i) {
+    PendingWrite pending = pending_writes[i];
+    write_down(core, pending.level, pending.address, pending.bytes);
+  }
+  // A write no private level allocated leaves nothing to track either.
+  if (hit_level < 0 || hit_level >= static_cast<int>(private_levels)) {
+    departed.push_back(block);
+  }
+  forget_departed(me);
+  me.latency.record(hit_level == REMOTE_HIT ? static_cast<int>(private_levels)
+                                            : hit_level,
+                    translation_cycles);
+  return hit_level;
+}
+
+uint64_t CoherentHierarchy::word_bit(size_t address) const {
+  size_t word = (address % block_size) / CACHE_WORD_BYTES;
+  return 1ULL << (word < 63 ? word : 63);
+}
+
+bool CoherentHierarchy::holds_modified(const Core &core,
+                                       size_t address) const {
+  for (const auto &level : core.levels) {
+    bool dirty = false;
+    if (level.probe(address, dirty) && dirty) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CoherentHierarchy::holds(const Core &core, size_t address) const {
+  for (const auto &level : core.levels) {
+    bool dirty = false;
+    if (level.probe(address, dirty)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// BusRdX: removes every other core's copy. Returns true when one of them
+// was Modified; its data is flushed to the shared levels.
+bool CoherentHierarchy::invalidate_others(size_t core, size_t address) {
+  size_t block = address - address % block_size;
+  uint64_t bit = word_bit(address);
+  bool flushed = false;
+
+  for (size_t other = 0; other < cores.size(); ++other) {
+    if (other == core) {
+      continue;
+    }
+    Core &victim = cores[other];
+    bool held = false;
+    for (auto &level : victim.levels) {
+      bool dirty = false;
+      if (level.snoop(address, true, dirty)) {
+        held = true;
+        flushed = flushed || dirty;
+      }
+    }
+    if (!held) {
+      continue;
+    }
+
+    ++cores[core].coherence.invalidations_sent;
+    ++victim.coherence.invalidations_received;
+    auto touched = victim.touched.find(block);
+    bool used = touched != victim.touched.end() && (touched->second & bit);
+    if (touched != victim.touched.end()) {
+      victim.touched.erase(touched);
+    }
+    mark_lost(victim, block);
+
+    if (!used) {
+      ++victim.coherence.false_sharing;
+    }
+    count_hotspot(block, !used);
+  }
+
+  if (flushed) {
+    pending_writes.push_back(PendingWrite(private_levels, block, block_size));
+  }
+  return flushed;
+}
+
+// BusRd: a Modified copy elsewhere is flushed and drops to Shared.
+bool CoherentHierarchy::downgrade_others(size_t core, size_t address) {
+  bool flushed = false;
+  for (size_t other = 0; other < cores.size(); ++other) {
+    if (other == core) {
+      continue;
+    }
+    for (auto &level : cores[other].levels) {
+      bool dirty = false;
+      if (level.snoop(address, false, dirty) && dirty) {
+        flushed = true;
+      }
+    }
+  }
+
+  if (flushed) {
+    pending_writes.push_back(PendingWrite(
+        private_levels, address - address % block_size, block_size));
+  }
+  return flushed;
+}
+
+// Remembers block in the core's ring of lost blocks, forgetting whichever
+// block last used that slot unless it was refetched and lost again since.
+void CoherentHierarchy::mark_lost(Core &core, size_t block) {
+  size_t &slot = core.lost_order[core.lost_next];
+  auto old = core.lost.find(slot);
+  if (old != core.lost.end() && old->second == core.lost_next) {
+    core.lost.erase(old);
+  }
+  slot = block;
+  core.lost[block] = core.lost_next;
+  core.lost_next = (core.lost_next + 1) % core.lost_order.size();
+}
+
+// Drops the word masks of blocks that are no longer in any private level.
+// Runs after the writebacks, which may have put a victim back in one.
+void CoherentHierarchy::forget_departed(Core &core) {
+  for (size_t address : departed) {
+    if (!holds(core, address)) {
+      core.touched.erase(address - address % block_size);
+    }
+  }
+}
+
+// Space-saving: a new block in a full table replaces the coldest one and
+// inherits its count.
+void CoherentHierarchy::count_hotspot(size_t block, bool false_sharing) {
+  auto found = hotspots.find(block);
+  if (found == hotspots.end()) {
+    uint64_t floor = 0;
+    if (hotspots.size() >= HOTSPOT_SLOTS) {
+      auto coldest = hotspot_order.begin();
+      floor = coldest->first;
+      hotspots.erase(coldest->second);
+      hotspot_order.erase(coldest);
+    }
+    found = hotspots.insert(make_pair(block, SharingHotspot(block, floor, 0)))
+                .first;
+  } else {
+    hotspot_order.erase(make_pair(found->second.invalidations, block));
+  }
+
+  SharingHotspot &spot = found->second;
+  ++spot.invalidations;
+  if (false_sharing) {
+    ++spot.false_sharing;
+  }
+  hotspot_order.insert(make_pair(spot.invalidations, block));
+}
+
+void CoherentHierarchy::write_down(size_t core, size_t level, size_t address,
+                                   size_t bytes) {
+  const vector<CacheLevel *> &chain = chains[core];
+  for (; level < chain.size(); ++level) {
+    CacheSpill spill;
+    bool kept = chain[level]->absorb_write(address, bytes, spill);
+    if (spill.evicted && level < private_levels) {
+      departed.push_back(spill.victim_address);
+    }
+    if (spill.victim_dirty) {
+      write_down(core, level + 1, spill.victim_address, block_size);
+    }
+    if (kept) {
+      return;
+    }
+  }
+}
+
+vector<CacheStats> CoherentHierarchy::get_core_stats(size_t core) const {
+  vector<CacheStats> out;
+  for (const auto &level : cores[core].levels) {
+    out.push_back(level.get_stats());
+  }
+  return out;
+}
+
+vector<CacheStats> CoherentHierarchy::get_shared_stats() const {
+  vector<CacheStats> out;
+  for (const auto &level : shared) {
+    out.push_back(level.get_stats());
+  }
+  return out;
+}
+
+vector<SharingHotspot> CoherentHierarchy::hottest_blocks(size_t count) const {
+  vector<SharingHotspot> out;
+  out.reserve(hotspots.size());
+  for (const auto &entry : hotspots) {
+    out.push_back(entry.second);
+  }
+
+  count = min(count, out.size());
+  partial_sort(out.begin(), out.begin() + count, out.end(),
+               [](const SharingHotspot &a, const SharingHotspot &b) {
+                 if (a.invalidations != b.invalidations) {
+                   return a.invalidations > b.invalidations;
+                 }
+                 return a.address < b.address;
+               });
+  out.resize(count);
+  return out;
+}
+
+void CoherentHierarchy::reset() {
+  for (auto &core : cores) {
+    for (auto &level : core.levels) {
+      level.reset();
+    }
+    core.coherence = CoherenceStats();
+    core.latency.reset();
+    core.touched.clear();
+    core.lost.clear();
+    fill(core.lost_order.begin(), core.lost_order.end(), 0);
+    core.lost_next = 0;
+  }
+  for (auto &level : shared) {
+    level.reset();
+  }
+  hotspots.clear();
+  hotspot_order.clear();
+}
@@ -0,0 +1,296 @@
+#include "../../include/parallel_cache.h"
+#include <algorithm>
+#include <chrono>
+
+ParallelCacheSim::ParallelCacheSim()
+    : shard_count(0), num_sets(0), block_size(0), pow2_shards(false),
+      block_shift(0), set_shift(0), shard_shift(0) {}
+
+ParallelCacheSim::~ParallelCacheSim() { stop(); }
+
+bool ParallelCacheSim::start(const vector<CacheConfig> &level_configs,
+                             InclusionPolicy inclusion, size_t threads) {
+  stop();
+  if (threads < 2 || level_configs.empty()) {
+    return false;
+  }
+  if (level_configs.size() > 1 && inclusion != InclusionPolicy::NINE) {
+    return false;
+  }
+  vector<CacheConfig> configs(level_configs);
+  for (CacheConfig &cfg : configs) {
+    if (cfg.prefetch.kind != PrefetchKind::NONE) {
+      return false;
+    }
+    if (inclusion == InclusionPolicy::EXCLUSIVE) {
+      cfg.write_allocate = true;
+    }
+  }
+
+  if (configs.size() > 1) {
+    for (size_t i = 0; i < configs.size(); ++i) {
+      workers.push_back(new Worker(configs[i], static_cast<int>(i)));
+      workers.back()->latency.set_levels(configs);
+      if (i > 0) {
+        workers[i - 1]->next = workers[i];
+      }
+    }
+  } else {
+    CacheLevel whole(configs[0]);
+    num_sets = whole.get_num_sets();
+    if (num_sets == 0) {
+      return false;
+    }
+    block_size = configs[0].block_size;
+
+    // The most shards up to threads that split the sets evenly.
+    shard_count = 1;
+    ReplacementPolicy policy = configs[0].policy;
+    if (policy != ReplacementPolicy::RANDOM &&
+        policy != ReplacementPolicy::BRRIP && !configs[0].classify_misses) {
+      for (size_t s = min(threads, num_sets); s > 1; --s) {
+        if (num_sets % s == 0) {
+          shard_count = s;
+          break;
+        }
+      }
+    }
+    pow2_shards = is_power_of_two(block_size) && is_power_of_two(num_sets) &&
+                  is_power_of_two(shard_count);
+    if (pow2_shards) {
+      block_shift = static_cast<unsigned>(__builtin_ctzll(block_size));
+      set_shift = static_cast<unsigned>(__builtin_ctzll(num_sets));
+      shard_shift = static_cast<unsigned>(__builtin_ctzll(shard_count));
+    }
+
+    CacheConfig shard = whole.get_config();
+    shard.size_bytes = num_sets / shard_count * shard.block_size *
+                       shard.associativity;
+    for (size_t s = 0; s < shard_count; ++s) {
+      workers.push_back(new Worker(shard, 0));
+      workers.back()->latency.set_levels(vector<CacheConfig>(1, shard));
+    }
+  }
+
+  for (Worker *worker : workers) {
+    worker->level.specialize();
+    worker->runner = thread(&ParallelCacheSim::run, worker);
+  }
+  return true;
+}
+
+void ParallelCacheSim::stop() {
+  if (workers.empty()) {
+    return;
+  }
+  sync();
+  for (Worker *worker : workers) {
+    worker->stopping.store(true, memory_order_release);
+  }
+  for (Worker *worker : workers) {
+    worker->runner.join();
+    delete worker;
+  }
+  workers.clear();
+  shard_count = 0;
+}
+
+// Routes an access to its shard, rewriting the address so the shard's
+// smaller level sees the same tag in set / shards, or to the first stage.
+void ParallelCacheSim::access(size_t address, AccessType type,
+                              uint64_t translation_cycles) {
+  Worker *to = workers[0];
+  if (shard_count > 1) {
+    size_t set, tag, offset;
+    if (pow2_shards) {
+      set = (address >> block_shift) & (num_sets - 1);
+      tag = address >> (block_shift + set_shift);
+      offset = address & (block_size - 1);
+      to = workers[set & (shard_count - 1)];
+      size_t local = (tag << (set_shift - shard_shift)) | (set >> shard_shift);
+      address = (local << block_shift) | offset;
+    } else {
+      size_t block = address / block_size;
+      set = block % num_sets;
+      tag = block / num_sets;
+      offset = address % block_size;
+      to = workers[set % shard_count];
+      size_t local = tag * (num_sets / shard_count) + set / shard_count;
+      address = local * block_size + offset;
+    }
+  }
+
+  to->inbox.push_back(Op(address, translation_cycles,
+                         type == AccessType::WRITE ? OP_WRITE : OP_READ));
+  if (to->inbox.size() >= BATCH) {
+    send(*to, to->inbox);
+  }
+}
+
+void ParallelCacheSim::send(Worker &to, vector<Op> &ops) {
+  size_t done = 0;
+  while (done < ops.size()) {
+    size_t n = to.input.push(&ops[done], ops.size() - done);
+    if (n == 0) {
+      this_thread::yield();
+    }
+    done += n;
+  }
+  to.received.fetch_add(ops.size(), memory_order_release);
+  ops.clear();
+}
+
+// Worker loop. A batch's output is sent before the batch counts as
+// processed, so once a stage has processed everything it received, the
+// next stage has received everything it will get.
+void ParallelCacheSim::run(Worker *worker) {
+  vector<Op> batch(BATCH);
+  size_t idle = 0;
+  while (true) {
+    size_t n = worker->input.pop(&batch[0], BATCH);
+    if (n == 0) {
+      // stop() syncs first, so an empty queue is final.
+      if (worker->stopping.load(memory_order_acquire)) {
+        return;
+      }
+      if (++idle < 64) {
+        this_thread::yield();
+      } else {
+        this_thread::sleep_for(chrono::microseconds(50));
+      }
+      continue;
+    }
+
+    idle = 0;
+    for (size_t i = 0; i < n; ++i) {
+      apply(*worker, batch[i]);
+    }
+    if (worker->next && !worker->outbox.empty()) {
+      send(*worker->next, worker->outbox);
+    }
+    worker->processed.fetch_add(n, memory_order_release);
+  }
+}
+
+// One step of CacheHierarchy's NINE walk at this worker's level. A demand
+// that misses goes on to the next stage; the level's own writebacks wait in
+// deferred until the writebacks from above have been applied.
+void ParallelCacheSim::apply(Worker &worker, const Op &op) {
+  const CacheConfig &cfg = worker.level.get_config();
+  CacheSpill spill;
+
+  switch (op.kind) {
+  case OP_READ:
+  case OP_WRITE: {
+    bool write = op.kind == OP_WRITE;
+    bool hit = worker.level.access(
+        op.address, write ? AccessType::WRITE : AccessType::READ, spill);
+    if (spill.victim_dirty) {
+      worker.deferred.push_back(
+          Op(spill.victim_address, cfg.block_size, OP_WRITEBACK));
+    }
+    if (spill.write_through) {
+      worker.deferred.push_back(
+          Op(op.address, CACHE_WORD_BYTES, OP_WRITEBACK));
+    }
+
+    if (hit) {
+      worker.latency.record(worker.stage, op.value);
+    } else if (!worker.next) {
+      worker.latency.record(-1, op.value);
+    } else {
+      // A level that allocated turns a write miss into a read fill.
+      OpKind down = write && !cfg.write_allocate ? OP_WRITE : OP_READ;
+      worker.outbox.push_back(Op(op.address, op.value, down));
+      worker.forwarded = true;
+    }
+    // The first stage gets nothing else for this access.
+    if (worker.stage == 0) {
+      finish_access(worker);
+    }
+    break;
+  }
+  case OP_WRITEBACK: {
+    bool kept = worker.level.absorb_write(op.address, op.value, spill);
+    if (worker.next) {
+      if (spill.victim_dirty) {
+        worker.outbox.push_back(
+            Op(spill.victim_address, cfg.block_size, OP_WRITEBACK));
+      }
+      if (!kept) {
+        worker.outbox.push_back(Op(op.address, op.value, OP_WRITEBACK));
+      }
+    }
+    break;
+  }
+  case OP_END:
+    finish_access(worker);
+    break;
+  }
+}
+
+void ParallelCacheSim::finish_access(Worker &worker) {
+  if (worker.next) {
+    worker.outbox.insert(worker.outbox.end(), worker.deferred.begin(),
+                         worker.deferred.end());
+    if (worker.forwarded) {
+      worker.outbox.push_back(Op(0, 0, OP_END));
+    }
+  }
+  worker.deferred.clear();
+  worker.forwarded = false;
+}
+
+// Flushes the reader's partial batches and waits for every stage in order.
+void ParallelCacheSim::sync() {
+  for (Worker *worker : workers) {
+    if (!worker->inbox.empty()) {
+      send(*worker, worker->inbox);
+    }
+  }
+  for (Worker *worker : workers) {
+    uint64_t total = worker->received.load(memory_order_acquire);
+    while (worker->processed.load(memory_order_acquire) != total) {
+      this_thread::yield();
+    }
+  }
+}
+
+vector<CacheStats> ParallelCacheSim::get_stats() {
+  sync();
+  vector<CacheStats> out;
+  if (shard_count <= 1) {
+    for (Worker *worker : workers) {
+      out.push_back(worker->level.get_stats());
+    }
+    return out;
+  }
+
+  CacheStats merged(workers[0]->level.get_config().name);
+  for (Worker *worker : workers) {
+    CacheStats st = worker->level.get_stats();
+    merged.accesses += st.accesses;
+    merged.hits += st.hits;
+    merged.misses += st.misses;
+    merged.writes += st.writes;
+    merged.dirty_evictions += st.dirty_evictions;
+    merged.writeback_bytes += st.writeback_bytes;
+  }
+  out.push_back(merged);
+  return out;
+}
+
+LatencyStats ParallelCacheSim::get_latency() {
+  sync();
+  LatencyStats merged;
+  for (Worker *worker : workers) {
+    const LatencyStats &lat = worker->latency.get_stats();
+    merged.accesses += lat.accesses;
+    merged.cache_cycles += lat.cache_cycles;
+    merged.translation_cycles += lat.translation_cycles;
+    for (size_t b = 0; b < merged.histogram.size(); ++b) {
+      merged.histogram[b] += lat.histogram[b];
+    }
+  }
+  return merged;
+}
@@ -0,0 +1,159 @@
+#include "../../include/prefetch.h"
+
+bool parse_prefetch_kind(const string &name, PrefetchKind &kind) {
+  if (name == "none") {
+    kind = PrefetchKind::NONE;
+  } else if (name == "next") {
+    kind = PrefetchKind::NEXT_LINE;
+  } else if (name == "stride") {
+    kind = PrefetchKind::STRIDE;
+  } else if (name == "stream") {
+    kind = PrefetchKind::STREAM;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *prefetch_kind_name(PrefetchKind kind) {
+  switch (kind) {
+  case PrefetchKind::NONE:
+    return "none";
+  case PrefetchKind::NEXT_LINE:
+    return "next";
+  case PrefetchKind::STRIDE:
+    return "stride";
+  case PrefetchKind::STREAM:
+    return "stream";
+  }
+  return "unknown";
+}
+
+void NextLinePrefetcher::observe(size_t block, bool hit, bool first_use,
+                                 vector<size_t> &requests) {
+  if (hit && !first_use) {
+    return;
+  }
+  for (size_t i = 0; i < config.degree; ++i) {
+    requests.push_back(block + config.distance + i);
+  }
+}
+
+StridePrefetcher::StridePrefetcher(const PrefetchConfig &config,
+                                   size_t block_size)
+    : Prefetcher(config),
+      blocks_per_region(block_size < REGION_BYTES ? REGION_BYTES / block_size
+                                                  : 1),
+      table(TABLE_ENTRIES) {}
+
+void StridePrefetcher::observe(size_t block, bool, bool,
+                               vector<size_t> &requests) {
+  size_t region = block / blocks_per_region;
+  Region &entry = table[region % TABLE_ENTRIES];
+
+  if (!entry.valid || entry.region != region) {
+    entry = Region();
+    entry.region = region;
+    entry.last_block = block;
+    entry.valid = true;
+    return;
+  }
+
+  int64_t delta =
+      static_cast<int64_t>(block) - static_cast<int64_t>(entry.last_block);
+  if (delta == 0) {
+    return;
+  }
+  entry.last_block = block;
+  if (delta == entry.stride) {
+    if (entry.confidence < CONFIRMED) {
+      ++entry.confidence;
+    }
+  } else {
+    entry.stride = delta;
+    entry.confidence = 0;
+  }
+  if (entry.confidence < CONFIRMED) {
+    return;
+  }
+
+  for (size_t i = 0; i < config.degree; ++i) {
+    int64_t target =
+        static_cast<int64_t>(block) +
+        entry.stride * static_cast<int64_t>(config.distance + i);
+    if (target >= 0) {
+      requests.push_back(static_cast<size_t>(target));
+    }
+  }
+}
+
+void StridePrefetcher::reset() {
+  table.assign(TABLE_ENTRIES, Region());
+}
+
+StreamBufferPrefetcher::StreamBufferPrefetcher(const PrefetchConfig &config)
+    : Prefetcher(config), streams(STREAM_BUFFERS), clock(0), taken_from(-1) {}
+
+bool StreamBufferPrefetcher::take(size_t block) {
+  for (size_t s = 0; s < streams.size(); ++s) {
+    deque<size_t> &blocks = streams[s].blocks;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      if (blocks[i] == block) {
+        blocks.erase(blocks.begin(), blocks.begin() + i + 1);
+        taken_from = static_cast<int>(s);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void StreamBufferPrefetcher::observe(size_t block, bool hit, bool,
+                                     vector<size_t> &requests) {
+  ++clock;
+  if (hit && taken_from < 0) {
+    return;
+  }
+
+  Stream *stream;
+  if (taken_from >= 0) {
+    stream = &streams[taken_from];
+    taken_from = -1;
+  } else {
+    stream = &streams[0];
+    for (auto &candidate : streams) {
+      if (candidate.last_use < stream->last_use) {
+        stream = &candidate;
+      }
+    }
+    stream->blocks.clear();
+    stream->next_block = block + config.distance;
+  }
+
+  stream->last_use = clock;
+  while (stream->blocks.size() < config.degree) {
+    stream->blocks.push_back(stream->next_block);
+    requests.push_back(stream->next_block);
+    ++stream->next_block;
+  }
+}
+
+void StreamBufferPrefetcher::reset() {
+  streams.assign(STREAM_BUFFERS, Stream());
+  clock = 0;
+  taken_from = -1;
+}
+
+Prefetcher *make_prefetcher(const PrefetchConfig &config, size_t block_size) {
+  switch (config.kind) {
+  case PrefetchKind::NEXT_LINE:
+    return new NextLinePrefetcher(config);
+  case PrefetchKind::STRIDE:
+    return new StridePrefetcher(config, block_size);
+  case PrefetchKind::STREAM:
+    return new StreamBufferPrefetcher(config);
+  case PrefetchKind::NONE:
+    break;
+  }
+  return nullptr;
+}
@@ -0,0 +1,203 @@
+#include "../../include/cache.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+static const uint64_t RANDOM_SEED = 0x9E3779B97F4A7C15ULL;
+// Low bit of every 2-bit RRPV lane.
+static const uint64_t RRPV_LOW_BITS = 0x5555555555555555ULL;
+
+bool parse_replacement_policy(const string &name, ReplacementPolicy &policy) {
+  if (name == "fifo") {
+    policy = ReplacementPolicy::FIFO;
+  } else if (name == "lru") {
+    policy = ReplacementPolicy::LRU;
+  } else if (name == "lfu") {
+    policy = ReplacementPolicy::LFU;
+  } else if (name == "tree_plru") {
+    policy = ReplacementPolicy::TREE_PLRU;
+  } else if (name == "bit_plru") {
+    policy = ReplacementPolicy::BIT_PLRU;
+  } else if (name == "srrip") {
+    policy = ReplacementPolicy::SRRIP;
+  } else if (name == "brrip") {
+    policy = ReplacementPolicy::BRRIP;
+  } else if (name == "random") {
+    policy = ReplacementPolicy::RANDOM;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *replacement_policy_name(ReplacementPolicy policy) {
+  switch (policy) {
+  case ReplacementPolicy::FIFO:
+    return "fifo";
+  case ReplacementPolicy::LRU:
+    return "lru";
+  case ReplacementPolicy::LFU:
+    return "lfu";
+  case ReplacementPolicy::TREE_PLRU:
+    return "tree_plru";
+  case ReplacementPolicy::BIT_PLRU:
+    return "bit_plru";
+  case ReplacementPolicy::SRRIP:
+    return "srrip";
+  case ReplacementPolicy::BRRIP:
+    return "brrip";
+  case ReplacementPolicy::RANDOM:
+    return "random";
+  }
+  return "unknown";
+}
+
+void CacheLevel::init_policy_metadata() {
+  size_t bits_per_set = 0;
+  switch (config.policy) {
+  case ReplacementPolicy::FIFO:
+  case ReplacementPolicy::LRU:
+  case ReplacementPolicy::LFU:
+    policy_state.assign(num_sets * num_ways, 0);
+    break;
+  case ReplacementPolicy::TREE_PLRU:
+    if (!is_power_of_two(num_ways)) {
+      throw runtime_error("E[Cache] tree_plru needs a power-of-two "
+                          "associativity");
+    }
+    bits_per_set = num_ways - 1;
+    break;
+  case ReplacementPolicy::BIT_PLRU:
+    bits_per_set = num_ways;
+    break;
+  case ReplacementPolicy::SRRIP:
+  case ReplacementPolicy::BRRIP:
+    bits_per_set = 2 * num_ways;
+    break;
+  case ReplacementPolicy::RANDOM:
+    break;
+  }
+
+  policy_words = (bits_per_set + 63) / 64;
+  policy_bits.assign(num_sets * policy_words, 0);
+  random_state = RANDOM_SEED;
+  brrip_fills = 0;
+}
+
+// Tree-PLRU: node n has children 2n + 1 and 2n + 2, and the leaves below
+// the last level are the ways. A node bit of 0 sends the victim search
+// left, 1 sends it right; touching a way points every node on its path
+// away from it. A 1-way set has no nodes (and no policy words), so there is
+// nothing to touch and the victim is way 0.
+void CacheLevel::tree_plru_touch(size_t set_index, size_t way) {
+  if (num_ways == 1) {
+    return;
+  }
+  uint64_t *bits = &policy_bits[set_index * policy_words];
+  size_t levels = static_cast<size_t>(__builtin_ctzll(num_ways));
+  size_t node = 0;
+  for (size_t level = 0; level < levels; ++level) {
+    uint64_t right = (way >> (levels - 1 - level)) & 1;
+    uint64_t bit = 1ULL << (node % 64);
+    if (right) {
+      bits[node / 64] &= ~bit;
+    } else {
+      bits[node / 64] |= bit;
+    }
+    node = 2 * node + 1 + right;
+  }
+}
+
+size_t CacheLevel::tree_plru_victim(size_t set_index) const {
+  if (num_ways == 1) {
+    return 0;
+  }
+  const uint64_t *bits = &policy_bits[set_index * policy_words];
+  size_t levels = static_cast<size_t>(__builtin_ctzll(num_ways));
+  size_t node = 0;
+  size_t way = 0;
+  for (size_t level = 0; level < levels; ++level) {
+    uint64_t right = (bits[node / 64] >> (node % 64)) & 1;
+    way = (way << 1) | right;
+    node = 2 * node + 1 + right;
+  }
+  return way;
+}
+
+// Bit-PLRU: a way's MRU bit is set when it is touched. Once every bit is set
+// the others are cleared, so some way always has a clear bit to evict.
+void CacheLevel::bit_plru_touch(size_t set_index, size_t way) {
+  uint64_t *bits = &policy_bits[set_index * policy_words];
+  bits[way / 64] |= 1ULL << (way % 64);
+
+  for (size_t word = 0; word < policy_words; ++word) {
+    size_t count = min<size_t>(64, num_ways - word * 64);
+    uint64_t all_ways = count == 64 ? ~0ULL : (1ULL << count) - 1;
+    if ((bits[word] & all_ways) != all_ways) {
+      return;
+    }
+  }
+
+  fill(bits, bits + policy_words, 0);
+  bits[way / 64] = 1ULL << (way % 64);
+}
+
+size_t CacheLevel::bit_plru_victim(size_t set_index) const {
+  const uint64_t *bits = &policy_bits[set_index * policy_words];
+  for (size_t word = 0; word < policy_words; ++word) {
+    size_t count = min<size_t>(64, num_ways - word * 64);
+    uint64_t all_ways = count == 64 ? ~0ULL : (1ULL << count) - 1;
+    uint64_t clear = ~bits[word] & all_ways;
+    if (clear) {
+      return word * 64 + __builtin_ctzll(clear);
+    }
+  }
+  return 0;
+}
+
+// RRIP: 2-bit re-reference prediction values packed 32 ways per word. The
+// victim is the first way predicted for distant re-reference (RRPV 3); if
+// there is none, every RRPV is aged by the amount that brings the largest
+// to 3, which is what repeated increment-and-retry would do.
+void CacheLevel::rrip_set(size_t set_index, size_t way, uint64_t rrpv) {
+  uint64_t &word = policy_bits[set_index * policy_words + way / 32];
+  unsigned shift = static_cast<unsigned>((way % 32) * 2);
+  word = (word & ~(3ULL << shift)) | (rrpv << shift);
+}
+
+size_t CacheLevel::rrip_victim(size_t set_index) {
+  uint64_t *rrpvs = &policy_bits[set_index * policy_words];
+
+  for (int pass = 0; pass < 2; ++pass) {
+    uint64_t any_high = 0;
+    uint64_t any_low = 0;
+    for (size_t word = 0; word < policy_words; ++word) {
+      size_t count = min<size_t>(32, num_ways - word * 32);
+      uint64_t lanes = RRPV_LOW_BITS >> (64 - 2 * count);
+      uint64_t distant = rrpvs[word] & (rrpvs[word] >> 1) & lanes;
+      if (distant) {
+        return word * 32 + __builtin_ctzll(distant) / 2;
+      }
+      any_high |= (rrpvs[word] >> 1) & lanes;
+      any_low |= rrpvs[word] & lanes;
+    }
+
+    uint64_t largest = any_high ? 2 : (any_low ? 1 : 0);
+    uint64_t age = RRPV_DISTANT - largest;
+    for (size_t word = 0; word < policy_words; ++word) {
+      size_t count = min<size_t>(32, num_ways - word * 32);
+      rrpvs[word] += age * (RRPV_LOW_BITS >> (64 - 2 * count));
+    }
+  }
+  return 0;
+}
+
+// xorshift64*, seeded at init and reset so runs are reproducible.
+size_t CacheLevel::random_victim() {
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return static_cast<size_t>((random_state * 0x2545F4914F6CDD1DULL) %
+                             num_ways);
+}
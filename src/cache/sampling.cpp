@@ -0,0 +1,142 @@
+#include "../../include/sampling.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// splitmix64 finalizer: spreads neighbouring unit indices across the range,
+// so the sampled sets are not clustered at low indices.
+static uint64_t hash_unit(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static size_t gcd_of(size_t a, size_t b) {
+  while (b != 0) {
+    size_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+SetSampler::SetSampler()
+    : units(0), sampled(0), levels(0), block_size(0), pow2_units(false),
+      block_shift(0), simulated(0), skipped(0) {}
+
+bool SetSampler::init(const vector<size_t> &level_sets, size_t block,
+                      double fraction) {
+  clear();
+  size_t common = 0;
+  for (size_t sets : level_sets) {
+    common = gcd_of(sets, common);
+  }
+  if (common < 2 || block == 0) {
+    return false;
+  }
+
+  units = common;
+  levels = level_sets.size();
+  block_size = block;
+  pow2_units = (block & (block - 1)) == 0 && (units & (units - 1)) == 0;
+  if (pow2_units) {
+    block_shift = static_cast<unsigned>(__builtin_ctzll(block));
+  }
+
+  // The units with the smallest hashes, numbered in unit order.
+  vector<pair<uint64_t, size_t>> order;
+  order.reserve(units);
+  for (size_t u = 0; u < units; ++u) {
+    order.push_back(make_pair(hash_unit(u), u));
+  }
+  sort(order.begin(), order.end());
+  sampled = static_cast<size_t>(llround(fraction * units));
+  sampled = max<size_t>(1, min(sampled, units));
+  slots.assign(units, static_cast<int>(SKIPPED));
+  for (size_t i = 0; i < sampled; ++i) {
+    slots[order[i].second] = 0;
+  }
+  int next = 0;
+  for (size_t u = 0; u < units; ++u) {
+    if (slots[u] == 0) {
+      slots[u] = next++;
+    }
+  }
+  counts.assign(sampled * levels * 2, 0);
+  return true;
+}
+
+void SetSampler::clear() {
+  units = 0;
+  sampled = 0;
+  levels = 0;
+  slots.clear();
+  counts.clear();
+  simulated = 0;
+  skipped = 0;
+}
+
+// Every level above the hit was looked up and missed.
+void SetSampler::record(int slot, int hit_level) {
+  ++simulated;
+  uint64_t *unit = &counts[static_cast<size_t>(slot) * levels * 2];
+  size_t probed = hit_level < 0 ? levels : static_cast<size_t>(hit_level) + 1;
+  for (size_t i = 0; i < probed; ++i) {
+    ++unit[i * 2];
+  }
+  if (hit_level >= 0) {
+    ++unit[hit_level * 2 + 1];
+  }
+}
+
+double SetSampler::scale() const {
+  return simulated > 0 ? static_cast<double>(total_accesses()) / simulated
+                       : 0.0;
+}
+
+// Ratio estimator over the sampled units: R = sum(hits) / sum(accesses),
+// with variance (1 - n/N) * s^2 / (n * mean_accesses^2), where s^2 is the
+// sample variance of hits - R * accesses across units.
+SampledEstimate SetSampler::estimate(size_t level) const {
+  SampledEstimate est;
+  if (!enabled() || level >= levels) {
+    return est;
+  }
+  double a = 0;
+  double h = 0;
+  for (size_t s = 0; s < sampled; ++s) {
+    a += counts[(s * levels + level) * 2];
+    h += counts[(s * levels + level) * 2 + 1];
+  }
+  double k = scale();
+  est.accesses = a * k;
+  est.hits = h * k;
+  est.misses = (a - h) * k;
+  if (a == 0) {
+    return est;
+  }
+  double ratio = h / a;
+  est.hit_ratio = ratio * 100.0;
+  if (sampled < 2) {
+    return est;
+  }
+
+  double spread = 0;
+  for (size_t s = 0; s < sampled; ++s) {
+    double d = counts[(s * levels + level) * 2 + 1] -
+               ratio * counts[(s * levels + level) * 2];
+    spread += d * d;
+  }
+  double n = static_cast<double>(sampled);
+  double mean = a / n;
+  double variance = (1.0 - n / units) * (spread / (n - 1)) / (n * mean * mean);
+  est.half_width = 1.96 * sqrt(variance) * 100.0;
+  return est;
+}
+
+void SetSampler::reset() {
+  fill(counts.begin(), counts.end(), 0);
+  simulated = 0;
+  skipped = 0;
+}
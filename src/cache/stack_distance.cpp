@@ -0,0 +1,145 @@
+#include "../../include/stack_distance.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+StackDistanceProfiler::StackDistanceProfiler()
+    : block_size(0), max_blocks(0), accesses(0), cold_misses(0) {}
+
+bool StackDistanceProfiler::init(size_t block, size_t num_sets,
+                                 size_t max_blocks) {
+  if (block == 0 || num_sets == 0) {
+    cerr << "E[Profile] Block size and set count must be positive" << endl;
+    return false;
+  }
+
+  block_size = block;
+  this->max_blocks = max_blocks;
+  accesses = cold_misses = 0;
+  stacks.assign(num_sets, SetStack());
+  last_slot.clear();
+  histogram.clear();
+  return true;
+}
+
+void StackDistanceProfiler::add_mark(vector<uint32_t> &marks, size_t slot,
+                                     int delta) {
+  for (size_t i = slot + 1; i <= marks.size(); i += i & (~i + 1)) {
+    marks[i - 1] += delta;
+  }
+}
+
+uint32_t StackDistanceProfiler::marks_through(const vector<uint32_t> &marks,
+                                              size_t slot) {
+  uint32_t count = 0;
+  for (size_t i = slot + 1; i > 0; i -= i & (~i + 1)) {
+    count += marks[i - 1];
+  }
+  return count;
+}
+
+// Lowest marked slot, found by descending the Fenwick tree in O(log n).
+size_t StackDistanceProfiler::first_mark(const vector<uint32_t> &marks) {
+  size_t step = 1;
+  while (step * 2 <= marks.size()) {
+    step *= 2;
+  }
+  size_t pos = 0;
+  for (; step > 0; step /= 2) {
+    if (pos + step <= marks.size() && marks[pos + step - 1] == 0) {
+      pos += step;
+    }
+  }
+  return pos;
+}
+
+// Forgets the least recently used block of the set.
+void StackDistanceProfiler::drop_deepest(SetStack &stack) {
+  size_t slot = first_mark(stack.marks);
+  last_slot.erase(stack.owners[slot]);
+  add_mark(stack.marks, slot, -1);
+  stack.owners[slot] = NO_BLOCK;
+  --stack.live;
+}
+
+// Renumbers the live slots 0..live-1 in stack order and leaves as many free
+// slots again, then rebuilds the Fenwick tree in O(slots).
+void StackDistanceProfiler::compact(SetStack &stack) {
+  size_t capacity = max(MIN_SLOTS, 2 * (static_cast<size_t>(stack.live) + 1));
+  vector<size_t> owners(capacity, NO_BLOCK);
+
+  uint32_t slot = 0;
+  for (size_t i = 0; i < stack.next_slot; ++i) {
+    if (stack.owners[i] != NO_BLOCK) {
+      owners[slot] = stack.owners[i];
+      last_slot[owners[slot]] = slot;
+      ++slot;
+    }
+  }
+
+  stack.owners.swap(owners);
+  stack.next_slot = slot;
+  stack.marks.assign(capacity, 0);
+  for (size_t i = 0; i < capacity; ++i) {
+    if (i < slot) {
+      stack.marks[i] += 1;
+    }
+    size_t parent = i + ((i + 1) & (~i));
+    if (parent < capacity) {
+      stack.marks[parent] += stack.marks[i];
+    }
+  }
+}
+
+size_t StackDistanceProfiler::access(size_t address) {
+  if (!enabled()) {
+    return COLD;
+  }
+
+  size_t block = address / block_size;
+  SetStack &stack = stacks[block % stacks.size()];
+  ++accesses;
+
+  size_t distance = COLD;
+  auto it = last_slot.find(block);
+  if (it == last_slot.end()) {
+    ++cold_misses;
+    if (max_blocks > 0 && stack.live >= max_blocks) {
+      drop_deepest(stack);
+    }
+    it = last_slot.emplace(block, 0).first;
+  } else {
+    uint32_t previous = it->second;
+    distance = stack.live - marks_through(stack.marks, previous);
+    if (distance >= histogram.size()) {
+      histogram.resize(distance + 1, 0);
+    }
+    ++histogram[distance];
+
+    add_mark(stack.marks, previous, -1);
+    stack.owners[previous] = NO_BLOCK;
+    --stack.live;
+  }
+
+  // Compaction rewrites other blocks' slots in last_slot but inserts no
+  // keys, so it stays valid.
+  if (stack.next_slot == stack.owners.size()) {
+    compact(stack);
+  }
+
+  uint32_t slot = stack.next_slot++;
+  add_mark(stack.marks, slot, 1);
+  stack.owners[slot] = block;
+  ++stack.live;
+  it->second = slot;
+  return distance;
+}
+
+uint64_t StackDistanceProfiler::hits_with_ways(size_t ways) const {
+  uint64_t hits = 0;
+  for (size_t d = 0; d < ways && d < histogram.size(); ++d) {
+    hits += histogram[d];
+  }
+  return hits;
+}
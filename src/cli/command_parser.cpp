@@ -1,5 +1,7 @@
 #include "../../include/cli.h"
 #include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -7,11 +9,19 @@
 using namespace std;
 
 CLI::CLI()
-    : allocator(nullptr), buddy_allocator(nullptr), use_buddy(false),
-      initialized(false), cache_hierarchy(), cache_initialized(false),
-      vm_manager(), vm_initialized(false) {}
+    : batch_mode(false), event_sink_set(false), events_enabled(false),
+      events(nullptr),
+      allocator(nullptr), buddy_allocator(nullptr), use_buddy(false),
+      use_boundary_tags(false), initialized(false), cache_hierarchy(),
+      cache_initialized(false), coherent_hierarchy(), cache_cores(1),
+      parallel_cache(), cache_threads(1), cache_sweep(), vm_manager(),
+      vm_initialized(false) {}
 
 CLI::~CLI() {
+  if (events) {
+    events->flush();
+    delete events;
+  }
   if (allocator) {
     delete allocator;
   }
@@ -55,12 +65,18 @@ CommandType CommandParser::get_command_type(const string &cmd) {
     return CommandType::CACHE_ACCESS;
   if (lower_cmd == "cache_stats")
     return CommandType::CACHE_STATS;
+  if (lower_cmd == "cache_sweep")
+    return CommandType::CACHE_SWEEP;
   if (lower_cmd == "vm_init")
     return CommandType::VM_INIT;
   if (lower_cmd == "vm_access")
     return CommandType::VM_ACCESS;
   if (lower_cmd == "vm_stats")
     return CommandType::VM_STATS;
+  if (lower_cmd == "profile_init")
+    return CommandType::PROFILE_INIT;
+  if (lower_cmd == "profile_stats")
+    return CommandType::PROFILE_STATS;
   if (lower_cmd == "help")
     return CommandType::HELP;
   return CommandType::UNKNOWN;
@@ -86,32 +102,100 @@ void CommandParser::print_help() {
   std::cout << "\n~~~~~~MNEMONIC Commands~~~~~" << std::endl;
   std::cout << "init memory <size>" << std::endl;
   std::cout << "set allocator <type>" << std::endl;
+  std::cout << "set boundary_tags <on|off>" << std::endl;
   std::cout << "malloc <size>" << std::endl;
   std::cout << "free <block_id>" << std::endl;
   std::cout << "dump" << std::endl;
   std::cout << "stats" << std::endl;
-  std::cout << "cache_init <L1_size> <L1_block> <L1_assoc> [L2_size L2_block "
-               "L2_assoc]"
+  std::cout << "cache_init [nine|inclusive|exclusive] [cores <n>] "
+               "[sample <fraction>] <L1_size> <L1_block> <L1_assoc> "
+               "[L1_options] [<size> <block> <assoc> [options]]..."
+            << std::endl;
+  std::cout << "                            - options: replacement policy, "
+               "wb|wt, wa|nwa, pf=next|stride|stream[:degree[:distance]]"
+            << std::endl;
+  std::cout << "                            - latency: lat=<hit>[:<miss>], "
+               "mem=<cycles> (last level)"
+            << std::endl;
+  std::cout << "                            - classify: 3C misses and reuse "
+               "distances"
             << std::endl;
   std::cout
-      << "                            - Configure 1- or 2-level cache hierarchy"
+      << "                            - Configure an N-level cache hierarchy"
       << std::endl;
-  std::cout << "cache_access <address>" << std::endl;
+  std::cout << "                            - cores > 1: private levels per "
+               "core, shared last level, MESI"
+            << std::endl;
+  std::cout << "                            - sample: simulate a hashed "
+               "fraction of the sets, estimate the rest"
+            << std::endl;
+  std::cout << "cache_sweep <sizes> <blocks> <assocs> [policies] [options] "
+               "[...]"
+            << std::endl;
+  std::cout << "                            - values: <n>, <a>,<b>,... or "
+               "<lo>..<hi> (doubling); one-pass sweep"
+            << std::endl;
+  std::cout << "cache_access <address> [r|w] [core]" << std::endl;
   std::cout << "cache_stats" << std::endl;
-  std::cout << "vm_init <vsize> <page> <psize>" << std::endl;
+  std::cout << "profile_init <block> [sets]" << std::endl;
+  std::cout << "                            - LRU stack-distance profile of "
+               "cache accesses"
+            << std::endl;
+  std::cout << "profile_stats [all]" << std::endl;
+  std::cout << "vm_init <vsize> <page> <psize> [walk=<cycles>] "
+               "[fault=<cycles>] [tlb=...] [tlb2=...]"
+            << std::endl;
+  std::cout << "                            - tlb: <entries>[:<ways>[:<policy>"
+               "[:<cycles>]]], L1 and L2 TLBs"
+            << std::endl;
   std::cout << "vm_access <vaddr>" << std::endl;
   std::cout << "vm_stats" << std::endl;
   std::cout << "help" << std::endl;
   std::cout << "exit" << std::endl;
   std::cout << std::endl;
 }
+bool CLI::set_event_sink(EventSinkType type, const string &output_path) {
+  ostream *out = &cout;
+  if (!output_path.empty()) {
+    if (event_file.is_open()) {
+      event_file.close();
+    }
+    event_file.open(output_path.c_str(), ios::out | ios::binary);
+    if (!event_file) {
+      cerr << "E[CLI] Cannot open event output: " << output_path << endl;
+      return false;
+    }
+    out = &event_file;
+  }
+
+  if (events) {
+    events->flush();
+    delete events;
+  }
+  events = make_event_sink(type, *out);
+  event_sink_set = true;
+  events_enabled = type != EventSinkType::NONE;
+  return true;
+}
+
 void CLI::run() {
-  cout << "~~~MNEMONIC~~~" << endl;
+  if (!event_sink_set) {
+    set_event_sink(batch_mode ? EventSinkType::NONE : EventSinkType::CONSOLE);
+  }
+
+  if (batch_mode) {
+    // Nothing is interactive: stop cin from flushing cout on every line.
+    cin.tie(nullptr);
+  } else {
+    cout << "~~~MNEMONIC~~~" << endl;
+  }
 
   string input;
 
   while (true) {
-    cout << "> ";
+    if (!batch_mode) {
+      cout << "> ";
+    }
     getline(cin, input);
     if (cin.eof()) {
       break;
@@ -122,12 +206,16 @@ void CLI::run() {
     Command cmd = CommandParser::parse(input);
 
     if (cmd.type == CommandType::EXIT) {
-      cout << "Exiting.." << endl;
+      if (!batch_mode) {
+        cout << "Exiting.." << endl;
+      }
       break;
     }
 
     execute_command(cmd);
   }
+
+  events->flush();
 }
 void CLI::execute_command(const Command &cmd) {
   switch (cmd.type) {
@@ -158,6 +246,9 @@ void CLI::execute_command(const Command &cmd) {
   case CommandType::CACHE_STATS:
     handle_cache_stats();
     break;
+  case CommandType::CACHE_SWEEP:
+    handle_cache_sweep(cmd.args);
+    break;
   case CommandType::VM_INIT:
     handle_vm_init(cmd.args);
     break;
@@ -167,6 +258,12 @@ void CLI::execute_command(const Command &cmd) {
   case CommandType::VM_STATS:
     handle_vm_stats();
     break;
+  case CommandType::PROFILE_INIT:
+    handle_profile_init(cmd.args);
+    break;
+  case CommandType::PROFILE_STATS:
+    handle_profile_stats(cmd.args);
+    break;
   case CommandType::HELP:
     CommandParser::print_help();
     break;
@@ -178,52 +275,407 @@ void CLI::execute_command(const Command &cmd) {
   }
 }
 
-void CLI::handle_cache_init(const vector<string> &args) {
-  if (args.size() != 3 && args.size() != 6) {
-    cerr << "W[Cache] Use cache_init <L1_size> <L1_block> <L1_assoc> [L2_size "
-            "L2_block L2_assoc]"
+static vector<string> split_fields(const string &text, char separator = ':') {
+  vector<string> parts;
+  size_t start = 0;
+  for (size_t colon; (colon = text.find(separator, start)) != string::npos;
+       start = colon + 1) {
+    parts.push_back(text.substr(start, colon - start));
+  }
+  parts.push_back(text.substr(start));
+  return parts;
+}
+
+// <kind>[:degree[:distance]], both counts at least 1.
+static bool parse_prefetch_option(const string &text, PrefetchConfig &config) {
+  vector<string> parts = split_fields(text);
+
+  PrefetchConfig parsed;
+  if (parts.size() > 3 || !parse_prefetch_kind(parts[0], parsed.kind)) {
+    return false;
+  }
+  try {
+    if (parts.size() > 1) {
+      parsed.degree = stoull(parts[1]);
+    }
+    if (parts.size() > 2) {
+      parsed.distance = stoull(parts[2]);
+    }
+  } catch (const exception &) {
+    return false;
+  }
+  if (parsed.degree == 0 || parsed.distance == 0) {
+    return false;
+  }
+  config = parsed;
+  return true;
+}
+
+// <hit>[:<miss_penalty>] in cycles.
+static bool parse_latency_option(const string &text, CacheConfig &config) {
+  vector<string> parts = split_fields(text);
+  if (parts.size() > 2) {
+    return false;
+  }
+  try {
+    size_t hit = stoull(parts[0]);
+    size_t miss = parts.size() > 1 ? stoull(parts[1]) : config.miss_penalty;
+    config.hit_latency = hit;
+    config.miss_penalty = miss;
+  } catch (const exception &) {
+    return false;
+  }
+  return true;
+}
+
+// One option of a cache level; reports a bad one and returns false.
+static bool parse_level_option(const string &arg, CacheConfig &cfg) {
+  if (arg.rfind("lat=", 0) == 0) {
+    if (!parse_latency_option(arg.substr(4), cfg)) {
+      cerr << "E[Cache] Bad latency: " << arg << " (lat=<hit>[:<miss>])"
+           << endl;
+      return false;
+    }
+  } else if (arg.rfind("mem=", 0) == 0) {
+    cfg.memory_latency = stoull(arg.substr(4));
+  } else if (arg.rfind("pf=", 0) == 0) {
+    if (!parse_prefetch_option(arg.substr(3), cfg.prefetch)) {
+      cerr << "E[Cache] Bad prefetcher: " << arg
+           << " (pf=next|stride|stream[:degree[:distance]])" << endl;
+      return false;
+    }
+  } else if (arg == "classify") {
+    cfg.classify_misses = true;
+  } else if (arg == "wb") {
+    cfg.write_policy = WritePolicy::WRITE_BACK;
+  } else if (arg == "wt") {
+    cfg.write_policy = WritePolicy::WRITE_THROUGH;
+  } else if (arg == "wa") {
+    cfg.write_allocate = true;
+  } else if (arg == "nwa") {
+    cfg.write_allocate = false;
+  } else if (!parse_replacement_policy(arg, cfg.policy)) {
+    cerr << "E[Cache] Unknown option: " << arg
+         << " (fifo, lru, lfu, tree_plru, bit_plru, srrip, brrip, "
+            "random, wb, wt, wa, nwa, pf=..., lat=..., mem=..., "
+            "classify)"
          << endl;
-    return;
+    return false;
   }
+  return true;
+}
 
+// A fraction of the sets in (0, 1], as a decimal or 1/<n>.
+static bool parse_sample_fraction(const string &text, double &fraction) {
   try {
-    size_t l1_size = stoull(args[0]);
-    size_t l1_block = stoull(args[1]);
-    size_t l1_assoc = stoull(args[2]);
+    size_t slash = text.find('/');
+    if (slash == string::npos) {
+      fraction = stod(text);
+    } else {
+      fraction = stod(text.substr(0, slash)) / stod(text.substr(slash + 1));
+    }
+  } catch (const exception &) {
+    return false;
+  }
+  return fraction > 0.0 && fraction <= 1.0;
+}
+
+void CLI::handle_cache_init(const vector<string> &args) {
+  const char *usage =
+      "W[Cache] Use cache_init [nine|inclusive|exclusive] [cores <n>] "
+      "[sample <fraction>] <L1_size> <L1_block> <L1_assoc> [L1_options] [<size> <block> <assoc> "
+      "[options]]...";
 
-    CacheConfig l1_cfg("L1", l1_size, l1_block, l1_assoc,
-                       ReplacementPolicy::FIFO);
+  try {
+    // An optional inclusion policy, core count and sampled fraction of the
+    // sets, then any number of levels, each three numbers followed by its
+    // options.
+    InclusionPolicy inclusion = InclusionPolicy::NINE;
+    size_t cores = 1;
+    double sample = 0.0;
+    size_t i = 0;
+    for (; i < args.size() && !isdigit(static_cast<unsigned char>(args[i][0]));
+         i++) {
+      if (args[i] == "cores" && i + 1 < args.size()) {
+        cores = stoull(args[++i]);
+      } else if (args[i] == "sample" && i + 1 < args.size()) {
+        if (!parse_sample_fraction(args[++i], sample)) {
+          cerr << "E[Cache] Bad sample fraction: " << args[i]
+               << " (0 < fraction <= 1, e.g. 0.05 or 1/16)" << endl;
+          return;
+        }
+      } else if (!parse_inclusion_policy(args[i], inclusion)) {
+        cerr << usage << endl;
+        return;
+      }
+    }
 
     vector<CacheConfig> cfgs;
-    cfgs.push_back(l1_cfg);
+    while (i < args.size()) {
+      if (i + 3 > args.size()) {
+        cerr << usage << endl;
+        return;
+      }
+
+      size_t size = stoull(args[i]);
+      size_t block = stoull(args[i + 1]);
+      size_t assoc = stoull(args[i + 2]);
+      i += 3;
+
+      string name = "L" + to_string(cfgs.size() + 1);
+      CacheConfig cfg(name, size, block, assoc);
 
-    if (args.size() == 6) {
-      size_t l2_size = stoull(args[3]);
-      size_t l2_block = stoull(args[4]);
-      size_t l2_assoc = stoull(args[5]);
-      CacheConfig l2_cfg("L2", l2_size, l2_block, l2_assoc,
-                         ReplacementPolicy::FIFO);
-      cfgs.push_back(l2_cfg);
+      // Options: a replacement policy, wb|wt, wa|nwa, a prefetcher,
+      // latencies and miss classification, in any order.
+      for (; i < args.size() && !isdigit(static_cast<unsigned char>(args[i][0]));
+           i++) {
+        if (!parse_level_option(args[i], cfg)) {
+          return;
+        }
+      }
+
+      cfgs.push_back(cfg);
+    }
+
+    if (cfgs.empty() || cores == 0) {
+      cerr << usage << endl;
+      return;
+    }
+    bool prefetching = false;
+    for (const CacheConfig &cfg : cfgs) {
+      prefetching = prefetching || cfg.prefetch.kind != PrefetchKind::NONE;
+    }
+    if (prefetching && (cores > 1 || inclusion == InclusionPolicy::EXCLUSIVE)) {
+      cerr << "E[Cache] Prefetchers need a single-core nine or inclusive "
+              "hierarchy"
+           << endl;
+      return;
+    }
+    // Prefetches and the shadow LRU reach across sets, and coherence ties
+    // cores together, so none of them survives dropping most of the sets.
+    bool classifying = false;
+    for (const CacheConfig &cfg : cfgs) {
+      classifying = classifying || cfg.classify_misses;
+    }
+    if (sample > 0.0 && (cores > 1 || prefetching || classifying)) {
+      cerr << "E[Cache] Set sampling needs a single-core hierarchy without "
+              "prefetchers or classify"
+           << endl;
+      return;
+    }
+    if (cores > 1 && (cfgs.size() < 2 || inclusion != InclusionPolicy::NINE)) {
+      cerr << "E[Cache] Multi-core needs a nine hierarchy with private levels "
+              "and a shared last level"
+           << endl;
+      return;
+    }
+    // Lines move whole between exclusive levels, and a block is the unit of
+    // coherence, so both need one block size.
+    if (inclusion == InclusionPolicy::EXCLUSIVE || cores > 1) {
+      for (const CacheConfig &cfg : cfgs) {
+        if (cfg.block_size != cfgs[0].block_size) {
+          cerr << "E[Cache] Exclusive and multi-core levels need equal block "
+                  "sizes"
+               << endl;
+          return;
+        }
+      }
     }
 
-    cache_hierarchy.set_levels(cfgs);
+    parallel_cache.stop();
+    cache_sweep.stop();
+    if (cores > 1) {
+      vector<CacheConfig> private_cfgs(cfgs.begin(), cfgs.end() - 1);
+      vector<CacheConfig> shared_cfgs(1, cfgs.back());
+      coherent_hierarchy.set_levels(cores, private_cfgs, shared_cfgs);
+      cache_cores = cores;
+      cache_initialized = true;
+      cout << "E[Cache] Cache init with " << cfgs.size() << " level(s) on "
+           << cores << " cores." << endl;
+      return;
+    }
+
+    cache_hierarchy.set_levels(cfgs, inclusion);
+    if (sample > 0.0 && !cache_hierarchy.set_sampling(sample)) {
+      cache_hierarchy.set_levels(vector<CacheConfig>(), inclusion);
+      cache_initialized = false;
+      cerr << "E[Cache] Set sampling needs one block size and set counts "
+              "with a common factor"
+           << endl;
+      return;
+    }
+    cache_cores = 1;
     cache_initialized = true;
+    // Per-op events need each access's hit level as it happens, so parallel
+    // runs are for event-free replays only. A sampled run is cheap enough
+    // on one thread.
+    if (cache_threads > 1 && !events_enabled && sample == 0.0 &&
+        parallel_cache.start(cfgs, inclusion, cache_threads)) {
+      cache_hierarchy.set_levels(vector<CacheConfig>(), inclusion);
+      cerr << "I[Cache] Parallel: " << parallel_cache.num_workers()
+           << (parallel_cache.sharded() ? " set shard(s)" : " pipeline stage(s)")
+           << endl;
+    }
 
     cout << "E[Cache] Cache init with " << cfgs.size() << " level(s)." << endl;
+  } catch (const runtime_error &e) {
+    cerr << e.what() << endl;
   } catch (const exception &) {
     cerr << "E[Cache] Invalid cache" << endl;
   }
 }
 
+// <n>, <a>,<b>,... or <lo>..<hi> (doubling from lo); every value above 0.
+static bool parse_sweep_axis(const string &text, vector<size_t> &values) {
+  values.clear();
+  try {
+    size_t dots = text.find("..");
+    if (dots != string::npos) {
+      size_t low = stoull(text.substr(0, dots));
+      size_t high = stoull(text.substr(dots + 2));
+      for (size_t v = low; v > 0 && v <= high; v *= 2) {
+        values.push_back(v);
+        if (v > high / 2) {
+          break;
+        }
+      }
+    } else {
+      for (const string &field : split_fields(text, ',')) {
+        values.push_back(stoull(field));
+      }
+    }
+  } catch (const exception &) {
+    return false;
+  }
+  return !values.empty() && find(values.begin(), values.end(), 0) ==
+                                values.end();
+}
+
+void CLI::handle_cache_sweep(const vector<string> &args) {
+  const char *usage =
+      "W[Cache] Use cache_sweep <sizes> <blocks> <assocs> [policies] "
+      "[options] [<sizes> <blocks> <assocs> [policies] [options]]...";
+
+  try {
+    // Groups like cache_init's levels, but each number may be a list or a
+    // doubling range and the policy a list. Every group expands to the
+    // product of its values, each one a single-level cache of its own.
+    vector<CacheConfig> cfgs;
+    size_t i = 0;
+    while (i < args.size()) {
+      if (i + 3 > args.size()) {
+        cerr << usage << endl;
+        return;
+      }
+      vector<size_t> axes[3];
+      for (size_t a = 0; a < 3; a++) {
+        if (!parse_sweep_axis(args[i + a], axes[a])) {
+          cerr << "E[Cache] Bad sweep values: " << args[i + a]
+               << " (<n>, <a>,<b>,... or <lo>..<hi>)" << endl;
+          return;
+        }
+      }
+      i += 3;
+
+      CacheConfig base;
+      vector<ReplacementPolicy> policies;
+      for (; i < args.size() && !isdigit(static_cast<unsigned char>(args[i][0]));
+           i++) {
+        // Prefetchers and miss classification belong to cache_init.
+        if (args[i].rfind("pf=", 0) == 0 || args[i] == "classify") {
+          cerr << "E[Cache] cache_sweep takes no pf= or classify" << endl;
+          return;
+        }
+        ReplacementPolicy policy;
+        if (args[i].find(',') != string::npos) {
+          for (const string &name : split_fields(args[i], ',')) {
+            if (!parse_replacement_policy(name, policy)) {
+              cerr << "E[Cache] Unknown policy: " << name << endl;
+              return;
+            }
+            policies.push_back(policy);
+          }
+        } else if (parse_replacement_policy(args[i], policy)) {
+          policies.push_back(policy);
+        } else if (!parse_level_option(args[i], base)) {
+          return;
+        }
+      }
+      if (policies.empty()) {
+        policies.push_back(base.policy);
+      }
+
+      for (size_t size : axes[0]) {
+        for (size_t block : axes[1]) {
+          for (size_t assoc : axes[2]) {
+            for (ReplacementPolicy policy : policies) {
+              CacheConfig cfg = base;
+              cfg.name = "C" + to_string(cfgs.size() + 1);
+              cfg.size_bytes = size;
+              cfg.block_size = block;
+              cfg.associativity = assoc;
+              cfg.policy = policy;
+              cfgs.push_back(cfg);
+            }
+          }
+        }
+      }
+    }
+
+    if (cfgs.empty()) {
+      cerr << usage << endl;
+      return;
+    }
+
+    parallel_cache.stop();
+    cache_hierarchy.set_levels(vector<CacheConfig>());
+    size_t skipped = 0;
+    if (!cache_sweep.start(cfgs, cache_threads, skipped)) {
+      cache_initialized = false;
+      cerr << "E[Cache] No valid configuration to sweep" << endl;
+      return;
+    }
+    cache_cores = 1;
+    cache_initialized = true;
+    if (skipped > 0) {
+      cerr << "W[Cache] Skipped " << skipped << " invalid configuration(s)"
+           << endl;
+    }
+    if (cache_sweep.num_workers() > 1) {
+      cerr << "I[Cache] Sweep: " << cache_sweep.num_workers()
+           << " worker thread(s)" << endl;
+    }
+    cout << "E[Cache] Cache sweep with " << cache_sweep.size()
+         << " configuration(s)." << endl;
+  } catch (const exception &) {
+    cerr << "E[Cache] Invalid cache sweep" << endl;
+  }
+}
+
 void CLI::handle_cache_access(const vector<string> &args) {
-  if (!cache_initialized) {
-    cerr << "W[Cache] Use 'cache_init' first." << endl;
+  if (args.empty() || args.size() > 3) {
+    cerr << "W[Cache] Use cache_access <address> [r|w] [core]" << endl;
     return;
   }
 
-  if (args.empty()) {
-    cerr << "W[Cache] Use cache_access <address>" << endl;
-    return;
+  AccessType type = AccessType::READ;
+  if (args.size() >= 2) {
+    if (args[1] == "w") {
+      type = AccessType::WRITE;
+    } else if (args[1] != "r") {
+      cerr << "W[Cache] Use cache_access <address> [r|w] [core]" << endl;
+      return;
+    }
+  }
+
+  size_t core = 0;
+  if (args.size() == 3) {
+    try {
+      core = stoull(args[2]);
+    } catch (const exception &) {
+      cerr << "E[Cache] Invalid core: " << args[2] << endl;
+      return;
+    }
   }
 
   try {
@@ -234,29 +686,221 @@ void CLI::handle_cache_access(const vector<string> &args) {
       address = stoull(args[0]);
     }
 
-    auto stats_before = cache_hierarchy.get_stats();
-    cache_hierarchy.access(address);
-    auto stats_after = cache_hierarchy.get_stats();
-    cout << "Address 0x" << hex << address << dec << " - ";
+    run_cache_access(address, type, core);
+  } catch (const exception &) {
+    cerr << "E[Cache] Invalid address: " << args[0] << endl;
+  }
+}
 
-    if (!stats_after.empty()) {
-      if (stats_after[0].hits > stats_before[0].hits) {
-        cout << "L1 HIT" << endl;
-      } else if (stats_after.size() > 1 &&
-                 stats_after[1].hits > stats_before[1].hits) {
-        cout << "L1 MISS, L2 HIT" << endl;
+void CLI::run_cache_access(size_t address, AccessType type, size_t core) {
+  stack_profiler.access(address);
+
+  if (!cache_initialized) {
+    if (!stack_profiler.enabled()) {
+      cerr << "W[Cache] Use 'cache_init' first." << endl;
+    }
+    return;
+  }
+  if (core >= cache_cores) {
+    cerr << "E[Cache] No core " << core << " (" << cache_cores << " core(s))"
+         << endl;
+    return;
+  }
+
+  if (cache_sweep.active()) {
+    cache_sweep.access(address, type);
+    return;
+  }
+  if (parallel_cache.active()) {
+    parallel_cache.access(address, type);
+    return;
+  }
+  if (cache_cores > 1) {
+    SimEvent event(EventKind::CACHE_ACCESS);
+    event.a = address;
+    event.flags = EVENT_FLAG_CORE;
+    if (type == AccessType::WRITE) {
+      event.flags |= EVENT_FLAG_WRITE;
+    }
+    event.level =
+        static_cast<int8_t>(coherent_hierarchy.access(core, address, type));
+    event.b = coherent_hierarchy.num_private_levels();
+    event.c = core;
+    event.d = coherent_hierarchy.num_levels();
+    events->emit(event);
+    return;
+  }
+
+  if (cache_hierarchy.empty()) {
+    cout << "Address 0x" << hex << address << dec
+         << " - Cache not initialized" << endl;
+    return;
+  }
+
+  SimEvent event(EventKind::CACHE_ACCESS);
+  event.a = address;
+  if (type == AccessType::WRITE) {
+    event.flags = EVENT_FLAG_WRITE;
+  }
+  event.level = static_cast<int8_t>(cache_hierarchy.access(address, type));
+  event.d = cache_hierarchy.num_levels();
+  events->emit(event);
+}
+
+static void print_level_stats(const CacheStats &st, const string &below,
+                              bool prefetching = false) {
+  cout << st.level_name << ":" << endl;
+  cout << "Accesses:" << st.accesses << endl;
+  cout << "Hits:" << st.hits << endl;
+  cout << "Misses:" << st.misses << endl;
+  cout << "Hit ratio:" << fixed << setprecision(2) << st.hit_ratio() << "%"
+       << endl;
+  cout << "Writes:" << st.writes << endl;
+  cout << "Dirty evictions:" << st.dirty_evictions << endl;
+  cout << "Bytes written to " << below << ":" << st.writeback_bytes << endl;
+  cout << "Back-invalidations:" << st.back_invalidations << endl;
+  cout << "Victims received:" << st.victims_received << endl;
+  if (prefetching) {
+    cout << "Prefetch fills:" << st.prefetch_fills << endl;
+    cout << "Useful prefetches:" << st.useful_prefetches << endl;
+    cout << "Late prefetches:" << st.late_prefetches << endl;
+    cout << "Prefetch pollution:" << st.prefetch_pollution << endl;
+  }
+  if (st.classified) {
+    cout << "Compulsory misses:" << st.compulsory_misses << endl;
+    cout << "Capacity misses:" << st.capacity_misses << endl;
+    cout << "Conflict misses:" << st.conflict_misses << endl;
+    // Distances 0, 1, 2-3, 4-7, ... below the line count, then the rest;
+    // first touches have none.
+    cout << "Reuse distance histogram:" << endl;
+    vector<uint64_t> buckets;
+    for (size_t d = 0; d < st.reuse_histogram.size(); d++) {
+      size_t b = d == 0 ? 0 : 64 - __builtin_clzll(d);
+      if (b >= buckets.size()) {
+        buckets.resize(b + 1, 0);
+      }
+      buckets[b] += st.reuse_histogram[d];
+    }
+    for (size_t b = 0; b < buckets.size(); b++) {
+      if (buckets[b] == 0) {
+        continue;
+      }
+      if (b < 2) {
+        cout << b;
       } else {
-        if (stats_after.size() > 1) {
-          cout << "L1 MISS, L2 MISS - Loaded from memory" << endl;
-        } else {
-          cout << "L1 MISS - Loaded from memory" << endl;
-        }
+        cout << (1ULL << (b - 1)) << "-" << (1ULL << b) - 1;
       }
-    } else {
-      cout << "Cache not initialized" << endl;
+      cout << ":" << buckets[b] << endl;
+    }
+    if (st.distant_reuses > 0) {
+      cout << st.reuse_histogram.size() << "+:" << st.distant_reuses << endl;
+    }
+  }
+}
+
+// Scaled counts of a set-sampled level, printed after its sampled stats.
+static void print_level_estimate(const SampledEstimate &est,
+                                 const CacheStats &st, const string &below,
+                                 double scale) {
+  cout << "Estimated accesses:" << llround(est.accesses) << endl;
+  cout << "Estimated hits:" << llround(est.hits) << endl;
+  cout << "Estimated misses:" << llround(est.misses) << endl;
+  cout << "Estimated hit ratio:" << fixed << setprecision(2) << est.hit_ratio
+       << "%";
+  if (est.half_width >= 0) {
+    cout << " +/- " << est.half_width << "% (95% CI)";
+  }
+  cout << endl;
+  cout << "Estimated bytes written to " << below << ":"
+       << llround(st.writeback_bytes * scale) << endl;
+}
+
+// Cycle totals, AMAT and the non-empty latency histogram buckets. A
+// set-sampled run scales the totals and buckets to the whole trace.
+static void print_latency(const LatencyStats &lat, double scale = 1.0) {
+  cout << "Cache cycles:" << llround(lat.cache_cycles * scale) << endl;
+  cout << "Translation cycles:" << llround(lat.translation_cycles * scale)
+       << endl;
+  cout << "Total cycles:" << llround(lat.total_cycles() * scale) << endl;
+  cout << "AMAT:" << fixed << setprecision(2) << lat.amat() << " cycles"
+       << endl;
+  cout << "Latency histogram:" << endl;
+  for (size_t b = 0; b < lat.histogram.size(); b++) {
+    if (lat.histogram[b] > 0) {
+      uint64_t low = b == 0 ? 0 : 1ULL << b;
+      cout << low << "-" << (2ULL << b) - 1
+           << " cycles:" << llround(lat.histogram[b] * scale) << endl;
     }
-  } catch (const exception &) {
-    cerr << "E[Cache] Invalid address: " << args[0] << endl;
+  }
+}
+
+// Per-core private levels and coherence counters, then the shared levels
+// and the blocks that lost the most copies to other cores' writes.
+static void print_coherent_stats(const CoherentHierarchy &hierarchy) {
+  vector<CacheStats> shared = hierarchy.get_shared_stats();
+
+  cout << "Cores:" << hierarchy.num_cores() << endl;
+  for (size_t c = 0; c < hierarchy.num_cores(); c++) {
+    vector<CacheStats> levels = hierarchy.get_core_stats(c);
+    cout << "Core " << c << ":" << endl;
+    for (size_t i = 0; i < levels.size(); i++) {
+      print_level_stats(levels[i], i + 1 < levels.size()
+                                       ? levels[i + 1].level_name
+                                       : shared[0].level_name);
+    }
+    const CoherenceStats &co = hierarchy.get_coherence_stats(c);
+    cout << "Coherence misses:" << co.coherence_misses << endl;
+    cout << "Invalidations sent:" << co.invalidations_sent << endl;
+    cout << "Invalidations received:" << co.invalidations_received << endl;
+    cout << "False-sharing invalidations:" << co.false_sharing << endl;
+    cout << "Cache-to-cache transfers:" << co.cache_to_cache << endl;
+    cout << "Upgrades:" << co.upgrades << endl;
+    print_latency(hierarchy.get_latency(c));
+  }
+
+  cout << "Shared:" << endl;
+  for (size_t i = 0; i < shared.size(); i++) {
+    print_level_stats(shared[i], i + 1 < shared.size()
+                                     ? shared[i + 1].level_name
+                                     : "memory");
+  }
+
+  vector<SharingHotspot> spots = hierarchy.hottest_blocks(5);
+  if (!spots.empty()) {
+    cout << "Sharing hot spots:" << endl;
+    for (const SharingHotspot &spot : spots) {
+      cout << "0x" << hex << spot.address << dec
+           << " invalidations:" << spot.invalidations
+           << " false sharing:" << spot.false_sharing << endl;
+    }
+  }
+}
+
+// One row per swept configuration, in the order cache_sweep listed them.
+static void print_sweep_results(CacheSweep &sweep) {
+  vector<CacheStats> stats = sweep.get_stats();
+  vector<LatencyStats> latency = sweep.get_latency();
+
+  cout << "Sweep:" << sweep.size() << " configuration(s)" << endl;
+  cout << "Accesses:" << (stats.empty() ? 0 : stats[0].accesses) << endl;
+  cout << left << setw(12) << "Size" << setw(8) << "Block" << setw(7)
+       << "Ways" << setw(11) << "Policy" << setw(8) << "Write" << setw(12)
+       << "Hits" << setw(12) << "Misses" << setw(11) << "Hit ratio"
+       << setw(17) << "Bytes to memory"
+       << "AMAT" << right << endl;
+  for (size_t i = 0; i < stats.size(); i++) {
+    const CacheConfig &cfg = sweep.get_config(i);
+    string write =
+        string(cfg.write_policy == WritePolicy::WRITE_BACK ? "wb" : "wt") +
+        (cfg.write_allocate ? "/wa" : "/nwa");
+    ostringstream ratio;
+    ratio << fixed << setprecision(2) << stats[i].hit_ratio() << "%";
+    cout << left << setw(12) << cfg.size_bytes << setw(8) << cfg.block_size
+         << setw(7) << cfg.associativity << setw(11)
+         << replacement_policy_name(cfg.policy) << setw(8) << write
+         << setw(12) << stats[i].hits << setw(12) << stats[i].misses
+         << setw(11) << ratio.str() << setw(17) << stats[i].writeback_bytes
+         << fixed << setprecision(2) << latency[i].amat() << right << endl;
   }
 }
 
@@ -266,23 +910,144 @@ void CLI::handle_cache_stats() {
     return;
   }
 
-  auto stats_vec = cache_hierarchy.get_stats();
-
   cout << "\n~~~~~~Cache Statistics~~~~~" << endl;
-  for (const auto &st : stats_vec) {
-    cout << st.level_name << ":" << endl;
-    cout << "Accesses:" << st.accesses << endl;
-    cout << "Hits:" << st.hits << endl;
-    cout << "Misses:" << st.misses << endl;
-    cout << "Hit ratio:" << fixed << setprecision(2) << st.hit_ratio() << "%"
+  if (cache_sweep.active()) {
+    print_sweep_results(cache_sweep);
+    cout << endl;
+    return;
+  }
+  if (cache_cores > 1) {
+    cout << "Inclusion:" << inclusion_policy_name(InclusionPolicy::NINE)
+         << endl;
+    print_coherent_stats(coherent_hierarchy);
+    cout << endl;
+    return;
+  }
+
+  bool parallel = parallel_cache.active();
+  auto stats_vec =
+      parallel ? parallel_cache.get_stats() : cache_hierarchy.get_stats();
+  cout << "Inclusion:" << inclusion_policy_name(cache_hierarchy.get_inclusion())
+       << endl;
+  // A sampled hierarchy's level stats cover the sampled sets only.
+  const SetSampler &sampler = cache_hierarchy.get_sampler();
+  double scale = 1.0;
+  if (sampler.enabled()) {
+    scale = sampler.scale();
+    cout << "Sampled sets:" << sampler.num_sampled() << "/"
+         << sampler.num_units() << " units (" << fixed << setprecision(2)
+         << 100.0 * sampler.num_sampled() / sampler.num_units() << "%)"
          << endl;
+    cout << "Simulated accesses:" << sampler.sampled_accesses() << "/"
+         << sampler.total_accesses() << endl;
+  }
+  for (size_t i = 0; i < stats_vec.size(); i++) {
+    string below =
+        i + 1 < stats_vec.size() ? stats_vec[i + 1].level_name : "memory";
+    print_level_stats(stats_vec[i], below,
+                      !parallel && cache_hierarchy.get_config(i).prefetch.kind !=
+                                       PrefetchKind::NONE);
+    if (sampler.enabled()) {
+      print_level_estimate(sampler.estimate(i), stats_vec[i], below, scale);
+    }
+  }
+  print_latency(parallel ? parallel_cache.get_latency()
+                         : cache_hierarchy.get_latency(),
+                scale);
+  cout << endl;
+}
+
+void CLI::handle_profile_init(const vector<string> &args) {
+  if (args.empty() || args.size() > 2) {
+    cerr << "W[Profile] Use profile_init <block> [sets]" << endl;
+    return;
+  }
+
+  try {
+    size_t block = stoull(args[0]);
+    size_t sets = args.size() == 2 ? stoull(args[1]) : 1;
+    if (stack_profiler.init(block, sets)) {
+      cout << "I[Profile] Stack-distance profile: block=" << block
+           << " bytes, sets=" << sets << endl;
+    }
+  } catch (const exception &) {
+    cerr << "E[Profile] Invalid profile" << endl;
+  }
+}
+
+void CLI::handle_profile_stats(const vector<string> &args) {
+  if (!stack_profiler.enabled()) {
+    cerr << "W[Profile] Use 'profile_init' first." << endl;
+    return;
+  }
+
+  bool every_size = !args.empty() && args[0] == "all";
+  const vector<uint64_t> &histogram = stack_profiler.get_histogram();
+  uint64_t accesses = stack_profiler.get_accesses();
+  size_t line_bytes =
+      stack_profiler.get_block_size() * stack_profiler.get_num_sets();
+
+  cout << "\n~~~~~~LRU Stack Distance Profile~~~~~" << endl;
+  cout << "Block size:" << stack_profiler.get_block_size() << " bytes" << endl;
+  cout << "Sets:" << stack_profiler.get_num_sets() << endl;
+  cout << "Accesses:" << accesses << endl;
+  cout << "Cold misses:" << stack_profiler.get_cold_misses() << endl;
+  cout << "Max reuse distance:"
+       << (histogram.empty() ? 0 : histogram.size() - 1) << endl;
+  cout << left << setw(10) << "Ways" << setw(14) << "Capacity" << setw(12)
+       << "Hits"
+       << "Hit ratio" << right << endl;
+
+  // Hits stop growing once ways exceeds the largest distance, so the table
+  // ends at the first size that covers every reuse.
+  uint64_t hits = 0;
+  size_t counted = 0;
+  for (size_t ways = 1;; ways = every_size ? ways + 1 : ways * 2) {
+    for (; counted < ways && counted < histogram.size(); ++counted) {
+      hits += histogram[counted];
+    }
+    double ratio =
+        accesses > 0 ? static_cast<double>(hits) / accesses * 100.0 : 0.0;
+    cout << left << setw(10) << ways << setw(14) << ways * line_bytes
+         << setw(12) << hits << fixed << setprecision(2) << ratio << "%"
+         << right << endl;
+    if (ways >= histogram.size()) {
+      break;
+    }
   }
   cout << endl;
 }
 
+// <entries>[:<ways>[:<policy>[:<cycles>]]]; ways default to entries (fully
+// associative) and must divide them.
+static bool parse_tlb_option(const string &text, TLBConfig &config) {
+  vector<string> parts = split_fields(text);
+  if (parts.size() > 4) {
+    return false;
+  }
+  try {
+    config.entries = stoull(parts[0]);
+    config.ways = parts.size() > 1 ? stoull(parts[1]) : config.entries;
+    if (parts.size() > 2 && !parse_replacement_policy(parts[2], config.policy)) {
+      return false;
+    }
+    if (parts.size() > 3) {
+      config.hit_cycles = stoull(parts[3]);
+    }
+  } catch (const exception &) {
+    return false;
+  }
+  return config.entries > 0 && config.ways > 0 &&
+         config.entries % config.ways == 0;
+}
+
 void CLI::handle_vm_init(const std::vector<std::string> &args) {
+  const char *usage =
+      "W[VM] Use vm_init <vsize> <page> <psize> [walk=<cycles>] "
+      "[fault=<cycles>] [tlb=<entries>[:<ways>[:<policy>[:<cycles>]]]] "
+      "[tlb2=...]";
   if (args.size() < 3) {
-    std::cerr << "W[VM] Use vm_init <vsize> <page> <psize>" << std::endl;
+    std::cerr << usage << std::endl;
     return;
   }
 
@@ -291,6 +1056,43 @@ void CLI::handle_vm_init(const std::vector<std::string> &args) {
     size_t page = std::stoull(args[1]);
     size_t psize = std::stoull(args[2]);
 
+    size_t walk = DEFAULT_PAGE_WALK_CYCLES;
+    size_t fault = DEFAULT_PAGE_FAULT_CYCLES;
+    std::vector<TLBConfig> tlbs;
+    TLBConfig l2_tlb;
+    for (size_t i = 3; i < args.size(); i++) {
+      if (args[i].rfind("walk=", 0) == 0) {
+        walk = std::stoull(args[i].substr(5));
+      } else if (args[i].rfind("fault=", 0) == 0) {
+        fault = std::stoull(args[i].substr(6));
+      } else if (args[i].rfind("tlb=", 0) == 0) {
+        TLBConfig l1(0, 0, ReplacementPolicy::LRU, 0);
+        if (!parse_tlb_option(args[i].substr(4), l1)) {
+          std::cerr << "E[VM] Bad TLB: " << args[i] << std::endl;
+          return;
+        }
+        tlbs.assign(1, l1);
+      } else if (args[i].rfind("tlb2=", 0) == 0) {
+        l2_tlb = TLBConfig(0, 0, ReplacementPolicy::LRU, DEFAULT_L2_TLB_CYCLES);
+        if (!parse_tlb_option(args[i].substr(5), l2_tlb)) {
+          std::cerr << "E[VM] Bad TLB: " << args[i] << std::endl;
+          return;
+        }
+      } else {
+        std::cerr << usage << std::endl;
+        return;
+      }
+    }
+    if (l2_tlb.entries > 0) {
+      if (tlbs.empty()) {
+        std::cerr << "E[VM] tlb2= needs an L1 TLB (tlb=)" << std::endl;
+        return;
+      }
+      tlbs.push_back(l2_tlb);
+    }
+    vm_manager.set_costs(walk, fault);
+    vm_manager.set_tlbs(tlbs);
+
     if (vm_manager.init(vsize, page, psize, PageReplacementPolicy::FIFO)) {
       vm_initialized = true;
     }
@@ -318,29 +1120,44 @@ void CLI::handle_vm_access(const std::vector<std::string> &args) {
       vaddr = std::stoull(args[0]);
     }
 
-    TranslationResult tr = vm_manager.access(vaddr);
-    if (!tr.success) {
-      std::cerr << "VM access error: " << tr.message << std::endl;
-      return;
-    }
+    run_vm_access(vaddr);
+  } catch (const std::exception &) {
+    std::cerr << "E[VM] Invalid virt. address: " << args[0] << std::endl;
+  }
+}
 
-    std::cout << "VM access: VA=0x" << std::hex << vaddr
-              << " (page=" << std::dec << tr.virtual_page << ") -> PA=0x"
-              << std::hex << tr.physical_address << " (frame=" << std::dec
-              << tr.frame_index << ")";
-    if (tr.page_fault) {
-      std::cout << " [PAGE FAULT]";
-    } else {
-      std::cout << " [HIT]";
-    }
-    std::cout << std::endl;
+void CLI::run_vm_access(size_t vaddr) {
+  if (!vm_initialized) {
+    std::cerr << "E[VM] Use 'vm_init' first." << std::endl;
+    return;
+  }
 
-    if (cache_initialized) {
-      cache_hierarchy.access(tr.physical_address);
-    }
+  TranslationResult tr = vm_manager.access(vaddr);
+  if (!tr.success) {
+    std::cerr << "VM access error: " << tr.message << std::endl;
+    return;
+  }
 
-  } catch (const std::exception &) {
-    std::cerr << "E[VM] Invalid virt. address: " << args[0] << std::endl;
+  SimEvent event(EventKind::VM_ACCESS);
+  event.a = vaddr;
+  event.b = tr.physical_address;
+  event.c = tr.virtual_page;
+  event.d = tr.frame_index;
+  if (tr.page_fault) {
+    event.flags |= EVENT_FLAG_PAGE_FAULT;
+  }
+  events->emit(event);
+
+  stack_profiler.access(tr.physical_address);
+  if (cache_initialized && cache_cores > 1) {
+    coherent_hierarchy.access(0, tr.physical_address, AccessType::READ,
+                              tr.cycles);
+  } else if (cache_sweep.active()) {
+    cache_sweep.access(tr.physical_address, AccessType::READ, tr.cycles);
+  } else if (parallel_cache.active()) {
+    parallel_cache.access(tr.physical_address, AccessType::READ, tr.cycles);
+  } else if (cache_initialized) {
+    cache_hierarchy.access(tr.physical_address, AccessType::READ, tr.cycles);
   }
 }
 
@@ -367,5 +1184,25 @@ void CLI::handle_vm_stats() {
             << s.hit_rate() << "%" << std::endl;
   std::cout << "Page fault rate:       " << std::fixed << std::setprecision(2)
             << s.fault_rate() << "%" << std::endl;
+  for (size_t i = 0; i < s.tlbs.size(); i++) {
+    const TLBConfig &tc = s.tlb_configs[i];
+    const CacheStats &t = s.tlbs[i];
+    std::string name = "L" + std::to_string(i + 1) + " TLB";
+    std::cout << name << ":" << tc.entries << " entries, " << tc.ways
+              << "-way, " << replacement_policy_name(tc.policy) << ", "
+              << tc.hit_cycles << " cycles" << std::endl;
+    std::cout << name << " reach:" << tc.entries * s.page_size << " bytes"
+              << std::endl;
+    std::cout << name << " hits:" << t.hits << std::endl;
+    std::cout << name << " misses:" << t.misses << std::endl;
+    std::cout << name << " hit rate:" << std::fixed << std::setprecision(2)
+              << t.hit_ratio() << "%" << std::endl;
+    std::cout << name << " shootdowns:" << t.back_invalidations << std::endl;
+  }
+  std::cout << "Page walks:" << s.page_walks << std::endl;
+  std::cout << "Page walk cycles:" << s.walk_cycles << std::endl;
+  std::cout << "Translation cycles:" << s.translation_cycles << std::endl;
+  std::cout << "Avg. translation cycles:" << std::fixed << std::setprecision(2)
+            << s.avg_translation_cycles() << std::endl;
   std::cout << std::endl;
 }
@@ -0,0 +1,151 @@
+#include "../../include/events.h"
+#include <iomanip>
+
+using namespace std;
+
+bool parse_event_sink_type(const string &name, EventSinkType &type) {
+  if (name == "console") {
+    type = EventSinkType::CONSOLE;
+  } else if (name == "none") {
+    type = EventSinkType::NONE;
+  } else if (name == "text") {
+    type = EventSinkType::TEXT;
+  } else if (name == "binary") {
+    type = EventSinkType::BINARY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+EventSink *make_event_sink(EventSinkType type, ostream &out) {
+  switch (type) {
+  case EventSinkType::CONSOLE:
+    return new ConsoleSink(out);
+  case EventSinkType::NONE:
+    return new NullSink();
+  case EventSinkType::TEXT:
+    return new TextSink(out);
+  case EventSinkType::BINARY:
+    return new BinarySink(out);
+  }
+  return new NullSink();
+}
+
+void ConsoleSink::emit(const SimEvent &e) {
+  bool buddy = (e.flags & EVENT_FLAG_BUDDY) != 0;
+
+  switch (e.kind) {
+  case EventKind::ALLOC:
+    if (buddy) {
+      out << "I[Buddy] Allocated block id=" << e.a << " at address=0x" << hex
+          << setw(4) << setfill('0') << e.b << dec << " (requested=" << e.c
+          << ", actual=" << e.d << ")" << endl;
+    } else {
+      out << "I[Allocator] Allocated block id=" << e.a << " at address=0x"
+          << hex << setw(4) << setfill('0') << e.b << dec << " (size=" << e.c
+          << ")" << endl;
+    }
+    break;
+  case EventKind::ALLOC_FAIL:
+    break;
+  case EventKind::FREE:
+    if (buddy) {
+      out << "I[Buddy] Block" << e.a << "freed" << endl;
+    } else {
+      out << "I[Deallocator] Block " << e.a << " freed" << endl;
+    }
+    break;
+  case EventKind::CACHE_ACCESS:
+  {
+    out << "Address 0x" << hex << e.a << dec;
+    if (e.flags & EVENT_FLAG_CORE) {
+      out << " (core " << e.c
+          << ((e.flags & EVENT_FLAG_WRITE) ? ", write) - " : ") - ");
+    } else {
+      out << ((e.flags & EVENT_FLAG_WRITE) ? " (write) - " : " - ");
+    }
+    // A set-sampled hierarchy skipped the block.
+    if (e.level == -3) {
+      out << "Not sampled" << endl;
+      break;
+    }
+    // Every level above the hit missed; a miss everywhere went to memory.
+    // A block from another core missed only the private levels.
+    bool remote = e.level == -2;
+    uint64_t probed = remote ? e.b : e.d;
+    for (uint64_t i = 0; i < probed; i++) {
+      if (i > 0) {
+        out << ", ";
+      }
+      if (static_cast<int>(i) == e.level) {
+        out << "L" << i + 1 << " HIT";
+        break;
+      }
+      out << "L" << i + 1 << " MISS";
+    }
+    if (remote) {
+      out << " - From another core";
+    } else if (e.level < 0) {
+      out << " - Loaded from memory";
+    }
+    out << endl;
+    break;
+  }
+  case EventKind::VM_ACCESS:
+    out << "VM access: VA=0x" << hex << e.a << " (page=" << dec << e.c
+        << ") -> PA=0x" << hex << e.b << " (frame=" << dec << e.d << ")";
+    if (e.flags & EVENT_FLAG_PAGE_FAULT) {
+      out << " [PAGE FAULT]";
+    } else {
+      out << " [HIT]";
+    }
+    out << endl;
+    break;
+  }
+}
+
+void TextSink::emit(const SimEvent &e) {
+  switch (e.kind) {
+  case EventKind::ALLOC:
+    out << "alloc " << e.a << ' ' << e.b << ' ' << e.c << ' ' << e.d << '\n';
+    break;
+  case EventKind::ALLOC_FAIL:
+    out << "alloc_fail " << e.c << '\n';
+    break;
+  case EventKind::FREE:
+    out << "free " << e.a << '\n';
+    break;
+  case EventKind::CACHE_ACCESS:
+    out << "cache " << e.a << ' ' << static_cast<int>(e.level);
+    if (e.flags & EVENT_FLAG_CORE) {
+      out << " c" << e.c;
+    }
+    out << ((e.flags & EVENT_FLAG_WRITE) ? " w\n" : "\n");
+    break;
+  case EventKind::VM_ACCESS:
+    out << "vm " << e.a << ' ' << e.b << ' '
+        << ((e.flags & EVENT_FLAG_PAGE_FAULT) ? "fault" : "hit") << '\n';
+    break;
+  }
+}
+
+static void put_u64(ostream &out, uint64_t v) {
+  char bytes[8];
+  for (int i = 0; i < 8; i++) {
+    bytes[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+  }
+  out.write(bytes, 8);
+}
+
+BinarySink::BinarySink(ostream &o) : out(o) { out.write("MNEVENT1", 8); }
+
+void BinarySink::emit(const SimEvent &e) {
+  char head[4] = {static_cast<char>(e.kind), static_cast<char>(e.flags),
+                  static_cast<char>(e.level), 0};
+  out.write(head, 4);
+  put_u64(out, e.a);
+  put_u64(out, e.b);
+  put_u64(out, e.c);
+  put_u64(out, e.d);
+}
@@ -24,6 +24,9 @@ void CLI::handle_init(const vector<string> &args) {
         buddy_allocator = new BuddyAllocator();
         cout << "I[Allocator] Using alloc: Buddy" << endl;
       }
+      if (use_boundary_tags) {
+        cerr << "W[Buddy] Boundary tags not supported, ignoring" << endl;
+      }
       if (buddy_allocator->init(size)) {
         initialized = true;
       }
@@ -33,6 +36,7 @@ void CLI::handle_init(const vector<string> &args) {
         cout << "I[Allocator] Default alloc: First Fit" << endl;
       }
 
+      allocator->set_boundary_tags(use_boundary_tags);
       if (allocator->init(size)) {
         initialized = true;
       }
@@ -44,6 +48,11 @@ void CLI::handle_init(const vector<string> &args) {
 }
 
 void CLI::handle_set_allocator(const vector<string> &args) {
+  if (args.size() >= 2 && args[0] == "boundary_tags") {
+    handle_set_boundary_tags(args[1]);
+    return;
+  }
+
   if (args.size() < 2 || args[0] != "allocator") {
     cerr << "W[CLI] Usage: set allocator <type>" << endl;
     return;
@@ -75,6 +84,10 @@ void CLI::handle_set_allocator(const vector<string> &args) {
   } else if (type == "worst_fit") {
     allocator = new WorstFitAllocator();
     cout << "I[Allocator] Alloc: Worst Fit" << endl;
+  } else if (type == "tlsf") {
+    allocator = new TLSFAllocator();
+    cout << "I[Allocator] Alloc: TLSF" << endl;
+    cout << "I[Allocator] Uses boundary tags for O(1) coalescing" << endl;
   } else if (type == "buddy") {
     buddy_allocator = new BuddyAllocator();
     use_buddy = true;
@@ -82,7 +95,27 @@ void CLI::handle_set_allocator(const vector<string> &args) {
     cout << "I[Allocator] Rounds sizes up to powers of two" << endl;
   } else {
     cerr << "Unknown alloc: " << type << endl;
-    cerr << "Available:first_fit, best_fit, worst_fit" << endl;
+    cerr << "Available:first_fit, best_fit, worst_fit, tlsf, buddy" << endl;
+  }
+}
+
+void CLI::handle_set_boundary_tags(const string &value) {
+  if (initialized) {
+    cerr << "E[Memory] Set boundary tags before 'init memory'" << endl;
+    return;
+  }
+
+  string mode = value;
+  transform(mode.begin(), mode.end(), mode.begin(), ::tolower);
+
+  if (mode == "on") {
+    use_boundary_tags = true;
+    cout << "I[Allocator] Boundary tags: on" << endl;
+  } else if (mode == "off") {
+    use_boundary_tags = false;
+    cout << "I[Allocator] Boundary tags: off" << endl;
+  } else {
+    cerr << "W[CLI] Usage: set boundary_tags <on|off>" << endl;
   }
 }
 
@@ -98,17 +131,43 @@ void CLI::handle_malloc(const vector<string> &args) {
   }
 
   try {
-    size_t size = stoull(args[0]);
-    if (use_buddy) {
-      buddy_allocator->allocate(size);
-    } else {
-      allocator->allocate(size);
-    }
+    run_malloc(stoull(args[0]));
   } catch (const exception &e) {
     cerr << "E[Memory] Invalid size: " << args[0] << endl;
   }
 }
 
+void CLI::run_malloc(size_t size) {
+  if (!initialized) {
+    cerr << "W[CLI] Use 'init memory <size>' first." << endl;
+    return;
+  }
+
+  SimEvent event(EventKind::ALLOC);
+  event.c = size;
+
+  bool success;
+  if (use_buddy) {
+    BuddyAllocationResult result = buddy_allocator->allocate(size);
+    success = result.success;
+    event.flags |= EVENT_FLAG_BUDDY;
+    event.a = result.block_id;
+    event.b = result.address;
+    event.d = result.actual_size;
+  } else {
+    AllocationResult result = allocator->allocate(size);
+    success = result.success;
+    event.a = result.block_id;
+    event.b = result.address;
+    event.d = size;
+  }
+
+  if (!success) {
+    event.kind = EventKind::ALLOC_FAIL;
+  }
+  events->emit(event);
+}
+
 void CLI::handle_free(const vector<string> &args) {
   if (!initialized) {
     cerr << "W[CLI] Use 'init memory <size>' first." << endl;
@@ -121,17 +180,30 @@ void CLI::handle_free(const vector<string> &args) {
   }
 
   try {
-    size_t block_id = stoull(args[0]);
-    if (use_buddy) {
-      buddy_allocator->deallocate(block_id);
-    } else {
-      allocator->deallocate(block_id);
-    }
+    run_free(stoull(args[0]));
   } catch (const exception &e) {
     cerr << "E[Memory] Invalid block ID: " << args[0] << endl;
   }
 }
 
+void CLI::run_free(size_t block_id) {
+  if (!initialized) {
+    cerr << "W[CLI] Use 'init memory <size>' first." << endl;
+    return;
+  }
+
+  bool freed = use_buddy ? buddy_allocator->deallocate(block_id)
+                         : allocator->deallocate(block_id);
+  if (freed) {
+    SimEvent event(EventKind::FREE);
+    event.a = block_id;
+    if (use_buddy) {
+      event.flags |= EVENT_FLAG_BUDDY;
+    }
+    events->emit(event);
+  }
+}
+
 void CLI::handle_dump() {
   if (!initialized) {
     cerr << "W[CLI] Use 'init memory <size>' first." << endl;
@@ -180,6 +252,14 @@ void CLI::handle_stats() {
   cout << "Allocation failure rate: " << failure_rate << "%" << endl;
   cout << "Allocated blocks: " << stats.num_allocated_blocks << endl;
   cout << "Free blocks: " << stats.num_free_blocks << endl;
+  cout << "Largest free block: " << stats.largest_free_block << " bytes"
+       << endl;
+  if (!use_buddy && allocator->uses_boundary_tags()) {
+    cout << "Boundary tag overhead: " << stats.tag_overhead_bytes << " bytes ("
+         << 2 * BOUNDARY_TAG_SIZE << " per block)" << endl;
+  }
+  cout << "Metadata nodes: " << stats.metadata_nodes << " ("
+       << stats.metadata_pool_bytes << " bytes pooled)" << endl;
   cout << "External fragmentation: " << fixed << setprecision(2)
        << stats.external_fragmentation << "%" << endl;
   cout << "Internal fragmentation: " << fixed << setprecision(2)
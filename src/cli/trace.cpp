@@ -0,0 +1,293 @@
+#include "../../include/trace.h"
+#include "../../include/cli.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+TraceReader::TraceReader()
+    : base(nullptr), cursor(nullptr), end(nullptr), mapped_size(0) {}
+
+TraceReader::~TraceReader() { close(); }
+
+bool TraceReader::open(const string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    cerr << "E[Trace] Cannot open " << path << endl;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)TRACE_MAGIC_SIZE) {
+    cerr << "E[Trace] Not a trace file: " << path << endl;
+    ::close(fd);
+    return false;
+  }
+
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    cerr << "E[Trace] mmap failed: " << path << endl;
+    return false;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  base = static_cast<const unsigned char *>(map);
+  mapped_size = st.st_size;
+  end = base + mapped_size;
+
+  if (memcmp(base, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0) {
+    cerr << "E[Trace] Bad trace header: " << path << endl;
+    close();
+    return false;
+  }
+  cursor = base + TRACE_MAGIC_SIZE;
+  return true;
+}
+
+void TraceReader::close() {
+  if (base) {
+    munmap(const_cast<unsigned char *>(base), mapped_size);
+  }
+  base = cursor = end = nullptr;
+  mapped_size = 0;
+}
+
+bool TraceReader::read_op(TraceOp &op) {
+  if (cursor >= end) {
+    return false;
+  }
+  op = static_cast<TraceOp>(*cursor++);
+  return true;
+}
+
+bool TraceReader::read_varint(uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64 && cursor < end; shift += 7) {
+    unsigned char byte = *cursor++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TraceReader::read_bytes(size_t length, const char *&bytes) {
+  if (static_cast<size_t>(end - cursor) < length) {
+    return false;
+  }
+  bytes = reinterpret_cast<const char *>(cursor);
+  cursor += length;
+  return true;
+}
+
+static void write_varint(ostream &out, uint64_t value) {
+  char buf[10];
+  size_t n = 0;
+  do {
+    unsigned char byte = value & 0x7f;
+    value >>= 7;
+    if (value) {
+      byte |= 0x80;
+    }
+    buf[n++] = static_cast<char>(byte);
+  } while (value);
+  out.write(buf, n);
+}
+
+static void write_op(ostream &out, TraceOp op) {
+  out.put(static_cast<char>(op));
+}
+
+static bool parse_number(const string &text, bool allow_hex,
+                         uint64_t &value) {
+  try {
+    size_t used = 0;
+    if (allow_hex && (text.rfind("0x", 0) == 0 || text.rfind("0X", 0) == 0)) {
+      value = stoull(text, &used, 16);
+    } else {
+      value = stoull(text, &used);
+    }
+    return used == text.size();
+  } catch (const exception &) {
+    return false;
+  }
+}
+
+bool convert_text_trace(const string &input_path, const string &output_path) {
+  ifstream in(input_path.c_str());
+  if (!in) {
+    cerr << "E[Trace] Cannot open " << input_path << endl;
+    return false;
+  }
+  ofstream out(output_path.c_str(), ios::out | ios::binary);
+  if (!out) {
+    cerr << "E[Trace] Cannot create " << output_path << endl;
+    return false;
+  }
+
+  out.write(TRACE_MAGIC, TRACE_MAGIC_SIZE);
+
+  string line;
+  size_t line_no = 0;
+  size_t records = 0;
+  uint64_t core = 0;
+  while (getline(in, line)) {
+    line_no++;
+    Command cmd = CommandParser::parse(line);
+    if (cmd.type == CommandType::UNKNOWN) {
+      if (line.find_first_not_of(" \t\r") != string::npos) {
+        cerr << "W[Trace] Skipping line " << line_no << ": " << line << endl;
+      }
+      continue;
+    }
+
+    TraceOp op = TraceOp::COMMAND;
+    switch (cmd.type) {
+    case CommandType::MALLOC:
+      op = TraceOp::MALLOC;
+      break;
+    case CommandType::FREE:
+      op = TraceOp::FREE;
+      break;
+    case CommandType::CACHE_ACCESS:
+      if (!cmd.args.empty() && cmd.args.size() <= 3) {
+        string mode = cmd.args.size() == 1 ? "r" : cmd.args[1];
+        if (mode == "r") {
+          op = TraceOp::CACHE_ACCESS;
+        } else if (mode == "w") {
+          op = TraceOp::CACHE_WRITE;
+        }
+      }
+      break;
+    case CommandType::VM_ACCESS:
+      op = TraceOp::VM_ACCESS;
+      break;
+    case CommandType::EXIT:
+      op = TraceOp::EXIT;
+      break;
+    default:
+      break;
+    }
+
+    uint64_t operand = 0;
+    bool allow_hex = op == TraceOp::CACHE_ACCESS ||
+                     op == TraceOp::CACHE_WRITE || op == TraceOp::VM_ACCESS;
+    bool numeric = allow_hex || op == TraceOp::MALLOC || op == TraceOp::FREE;
+    if (numeric && (cmd.args.empty() ||
+                    !parse_number(cmd.args[0], allow_hex, operand))) {
+      // Keep malformed lines as text so replay reports them like the CLI.
+      op = TraceOp::COMMAND;
+    }
+
+    // The core only changes between runs of records, so it is a record of
+    // its own rather than an operand of every access.
+    if (op == TraceOp::CACHE_ACCESS || op == TraceOp::CACHE_WRITE) {
+      uint64_t access_core = 0;
+      if (cmd.args.size() == 3 &&
+          !parse_number(cmd.args[2], false, access_core)) {
+        op = TraceOp::COMMAND;
+      } else if (access_core != core) {
+        write_op(out, TraceOp::CACHE_CORE);
+        write_varint(out, access_core);
+        core = access_core;
+        records++;
+      }
+    }
+
+    write_op(out, op);
+    if (op == TraceOp::COMMAND) {
+      write_varint(out, line.size());
+      out.write(line.data(), line.size());
+    } else if (op != TraceOp::EXIT) {
+      write_varint(out, operand);
+    }
+    records++;
+  }
+
+  if (!out) {
+    cerr << "E[Trace] Write failed: " << output_path << endl;
+    return false;
+  }
+
+  cout << "I[Trace] Wrote " << records << " records to " << output_path
+       << endl;
+  return true;
+}
+
+bool CLI::replay(const string &path) {
+  TraceReader reader;
+  if (!reader.open(path)) {
+    return false;
+  }
+
+  if (!event_sink_set) {
+    set_event_sink(batch_mode ? EventSinkType::NONE : EventSinkType::CONSOLE);
+  }
+
+  TraceOp op;
+  uint64_t operand;
+  const char *text;
+  uint64_t core = 0;
+  bool ok = true;
+
+  while (reader.read_op(op)) {
+    if (op == TraceOp::EXIT) {
+      break;
+    }
+    if (op == TraceOp::COMMAND) {
+      if (!reader.read_varint(operand) || !reader.read_bytes(operand, text)) {
+        ok = false;
+        break;
+      }
+      execute_command(CommandParser::parse(string(text, operand)));
+      continue;
+    }
+    if (!reader.read_varint(operand)) {
+      ok = false;
+      break;
+    }
+
+    switch (op) {
+    case TraceOp::MALLOC:
+      run_malloc(operand);
+      break;
+    case TraceOp::FREE:
+      run_free(operand);
+      break;
+    case TraceOp::CACHE_ACCESS:
+      run_cache_access(operand, AccessType::READ, core);
+      break;
+    case TraceOp::CACHE_WRITE:
+      run_cache_access(operand, AccessType::WRITE, core);
+      break;
+    case TraceOp::CACHE_CORE:
+      core = operand;
+      break;
+    case TraceOp::VM_ACCESS:
+      run_vm_access(operand);
+      break;
+    default:
+      ok = false;
+      break;
+    }
+    if (!ok) {
+      break;
+    }
+  }
+
+  if (!ok) {
+    cerr << "E[Trace] Corrupt trace: " << path << endl;
+  }
+  events->flush();
+  return ok;
+}
@@ -1,7 +1,68 @@
 #include "../include/cli.h"
+#include "../include/trace.h"
+#include <cstdlib>
+#include <iostream>
+
+static void print_usage() {
+  cerr << "Usage: mnemonic [--batch] [--events=console|none|text|binary]"
+          " [--events-out=<file>] [--threads <n>] [--replay <trace>]"
+       << endl;
+  cerr << "       mnemonic --convert <workload.txt> <trace>" << endl;
+}
+
+int main(int argc, char **argv) {
+  bool batch = false;
+  string sink_name;
+  string sink_path;
+  string replay_path;
+  size_t threads = 1;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--convert" && i + 2 < argc) {
+      return convert_text_trace(argv[i + 1], argv[i + 2]) ? 0 : 1;
+    } else if (arg == "--replay" && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (arg == "--threads" && i + 1 < argc) {
+      threads = strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--batch") {
+      batch = true;
+    } else if (arg.rfind("--events=", 0) == 0) {
+      sink_name = arg.substr(9);
+    } else if (arg.rfind("--events-out=", 0) == 0) {
+      sink_path = arg.substr(13);
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+
+  if (batch) {
+    ios::sync_with_stdio(false);
+  }
 
-int main() { 
   CLI cli;
+  cli.set_batch_mode(batch);
+  cli.set_cache_threads(threads);
+
+  if (!sink_name.empty() || !sink_path.empty()) {
+    EventSinkType type = batch ? EventSinkType::NONE : EventSinkType::CONSOLE;
+    if (sink_name.empty() && !sink_path.empty()) {
+      type = EventSinkType::TEXT;
+    }
+    if (!sink_name.empty() && !parse_event_sink_type(sink_name, type)) {
+      print_usage();
+      return 1;
+    }
+    if (!cli.set_event_sink(type, sink_path)) {
+      return 1;
+    }
+  }
+
+  if (!replay_path.empty()) {
+    return cli.replay(replay_path) ? 0 : 1;
+  }
+
   cli.run();
   return 0;
 }
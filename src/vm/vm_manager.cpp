@@ -5,7 +5,9 @@
 VirtualMemoryManager::VirtualMemoryManager()
     : initialized(false), virtual_size_bytes(0), physical_size_bytes(0),
       page_size(0), num_virtual_pages(0), num_frames(0),
-      policy(PageReplacementPolicy::FIFO), global_time(0) {}
+      policy(PageReplacementPolicy::FIFO),
+      page_walk_cycles(DEFAULT_PAGE_WALK_CYCLES),
+      page_fault_cycles(DEFAULT_PAGE_FAULT_CYCLES), global_time(0) {}
 
 bool VirtualMemoryManager::init(size_t vsize, size_t page_sz, size_t psize,
                                 PageReplacementPolicy pol) {
@@ -30,6 +32,18 @@ bool VirtualMemoryManager::init(size_t vsize, size_t page_sz, size_t psize,
     return false;
   }
 
+  // May throw for a geometry no CacheLevel can have; nothing is changed yet.
+  vector<CacheLevel> levels;
+  for (size_t i = 0; i < tlb_request.size(); ++i) {
+    const TLBConfig &tc = tlb_request[i];
+    CacheConfig cfg("TLB" + to_string(i + 1), tc.entries, 1,
+                    tc.ways == 0 ? tc.entries : tc.ways, tc.policy);
+    levels.push_back(CacheLevel(cfg));
+    levels.back().specialize();
+  }
+  tlbs.swap(levels);
+  tlb_configs = tlb_request;
+
   virtual_size_bytes = vsize;
   physical_size_bytes = psize;
   page_size = page_sz;
@@ -48,6 +62,7 @@ bool VirtualMemoryManager::init(size_t vsize, size_t page_sz, size_t psize,
   stats.page_size = page_size;
   stats.num_virtual_pages = num_virtual_pages;
   stats.num_frames = num_frames;
+  stats.tlb_configs = tlb_configs;
 
   initialized = true;
 
@@ -103,6 +118,10 @@ void VirtualMemoryManager::load_page_into_frame(size_t vpage,
     int existing_vpage = frame_to_vpage[frame_index];
     if (existing_vpage >= 0) {
       page_table[static_cast<size_t>(existing_vpage)].valid = false;
+      for (CacheLevel &tlb : tlbs) {
+        bool dirty = false;
+        tlb.invalidate(static_cast<size_t>(existing_vpage), dirty);
+      }
     }
   }
 
@@ -115,6 +134,20 @@ void VirtualMemoryManager::load_page_into_frame(size_t vpage,
   pte.last_access_time = global_time;
 }
 
+// Looks vpage up in each TLB level in turn, adding its cost; a miss fills
+// the level. Returns true on a hit, false when the page table must be
+// walked.
+bool VirtualMemoryManager::lookup_tlbs(size_t vpage, size_t &cycles) {
+  for (size_t i = 0; i < tlbs.size(); ++i) {
+    cycles += tlb_configs[i].hit_cycles;
+    CacheSpill spill;
+    if (tlbs[i].access(vpage, AccessType::READ, spill)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 TranslationResult VirtualMemoryManager::access(size_t vaddr) {
   TranslationResult res;
   res.virtual_address = vaddr;
@@ -139,9 +172,15 @@ TranslationResult VirtualMemoryManager::access(size_t vaddr) {
   res.virtual_page = vpage;
 
   PageTableEntry &pte = page_table[vpage];
+  if (tlbs.empty() || !lookup_tlbs(vpage, res.cycles)) {
+    ++stats.page_walks;
+    stats.walk_cycles += page_walk_cycles;
+    res.cycles += page_walk_cycles;
+  }
 
   if (pte.valid) {
     ++stats.page_hits;
+    stats.translation_cycles += res.cycles;
     pte.last_access_time = global_time;
 
     size_t frame_index = pte.frame_index;
@@ -155,6 +194,8 @@ TranslationResult VirtualMemoryManager::access(size_t vaddr) {
 
   ++stats.page_faults;
   res.page_fault = true;
+  res.cycles += page_fault_cycles;
+  stats.translation_cycles += res.cycles;
   size_t frame_index = choose_victim_frame();
   bool evict = (frame_to_vpage[frame_index] != -1);
 
@@ -168,7 +209,13 @@ TranslationResult VirtualMemoryManager::access(size_t vaddr) {
   return res;
 }
 
-VMStats VirtualMemoryManager::get_stats() const { return stats; }
+VMStats VirtualMemoryManager::get_stats() const {
+  VMStats out = stats;
+  for (const CacheLevel &tlb : tlbs) {
+    out.tlbs.push_back(tlb.get_stats());
+  }
+  return out;
+}
 
 void VirtualMemoryManager::reset() {
   if (!initialized)
@@ -182,4 +229,10 @@ void VirtualMemoryManager::reset() {
   stats.accesses = 0;
   stats.page_hits = 0;
   stats.page_faults = 0;
+  stats.translation_cycles = 0;
+  stats.page_walks = 0;
+  stats.walk_cycles = 0;
+  for (CacheLevel &tlb : tlbs) {
+    tlb.reset();
+  }
 }